@@ -1,25 +1,52 @@
 #include "command.hpp"
+#include "async_io.hpp"
+#include "buffer_pool.hpp"
+#include "buffer_ring.hpp"
+#include "byte_size.hpp"
+#include "chunk_scheduler.hpp"
+#include "collection_listing.hpp"
+#include "range_window.hpp"
+#include "rate_limiter.hpp"
+#include "retry_policy.hpp"
+#include "sha256_digest.hpp"
+#include "transfer_scheduler.hpp"
 
 #include <irods/rodsClient.h>
 #include <irods/connection_pool.hpp>
+#include <irods/thread_pool.hpp>
 #include <irods/dstream.hpp>
 #include <irods/transport/default_transport.hpp>
 #include <irods/filesystem.hpp>
 
 #include <boost/config.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <string>
-#include <array>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #define CLI_COMMAND_NAME get
 
-namespace fs = irods::experimental::filesystem::client;
-namespace io = irods::experimental::io;
+namespace fs  = irods::experimental::filesystem::client;
+namespace ifs = irods::experimental::filesystem;
+namespace io  = irods::experimental::io;
 
-namespace po = boost::program_options;
+namespace po  = boost::program_options;
+namespace bfs = boost::filesystem;
 
 namespace irods::cli
 {
@@ -33,12 +60,36 @@ namespace irods::cli
 
         auto description() const noexcept -> std::string_view override
         {
-            return "Downloads data object to local disk.";
+            return "Downloads data objects and collections to local disk.";
         }
 
         auto help_text() const noexcept -> std::string_view override
         {
-            return "The help text";
+            return R"(
+Downloads a data object to a local file. Use '-' to write to stdout.
+With -r, downloads a collection and everything below it into a local
+directory tree.
+
+irods get [options] logical_path physical_path
+irods get [options] -r logical_path physical_path
+
+      --recursive, -r            : download a collection; if physical_path is an existing directory, the collection is placed inside it
+      --connection_pool_size, -c : number of connections used for collection downloads (default: 4)
+      --connections              : number of parallel streams used for a large data object (default: derived from link speed)
+      --chunk-size               : size of each range fetched by a stream, e.g. 64M (default: derived from object size and link speed)
+      --link-speed               : link speed in Gbit/s used to derive the defaults above (default: 10)
+      --retries                  : number of times a failed range is fetched again, each time on a new connection (default: 3)
+      --read-ahead               : number of ranges fetched ahead over separate connections when writing to stdout; they are
+                                   written in order, holding at most read-ahead * chunk-size bytes, and 1 uses a single stream
+                                   (default: the number of connections for a large data object, otherwise 1)
+      --buffer-count             : number of buffers between a single-stream download and stdout (default: 4)
+      --buffer-size              : size of each transfer buffer, e.g. 8M (default: 4M)
+      --memory-limit             : upper limit on the memory held in transfer buffers, e.g. 512M (default: unlimited)
+      --huge-pages               : back transfer buffers with transparent huge pages
+      --checksum                 : compute a SHA-256 checksum of the data while it is received and compare it with the server's checksum
+      --max-bandwidth            : upper limit on the bytes received per second, e.g. 500M (default: unlimited)
+      --max-opens                : upper limit on the data objects opened per second (default: unlimited)
+      --limits-file              : file to re-read the two limits above from while the download runs, one "max-bandwidth 500M" or "max-opens 100" per line)";
         }
 
         auto execute(const std::vector<std::string>& args) -> int override
@@ -46,7 +97,22 @@ namespace irods::cli
             po::options_description desc{""};
             desc.add_options()
                 ("logical_path", po::value<std::string>(), "")
-                ("physical_path", po::value<std::string>(), "");
+                ("physical_path", po::value<std::string>(), "")
+                ("recursive,r", "")
+                ("connection_pool_size,c", po::value<int>()->default_value(4), "")
+                ("connections", po::value<int>()->default_value(0), "")
+                ("chunk-size", po::value<std::string>(), "")
+                ("link-speed", po::value<double>()->default_value(10.0), "")
+                ("retries", po::value<int>()->default_value(3), "")
+                ("read-ahead", po::value<int>()->default_value(0), "")
+                ("buffer-count", po::value<int>()->default_value(4), "")
+                ("buffer-size", po::value<std::string>()->default_value("4M"), "")
+                ("memory-limit", po::value<std::string>()->default_value("0"), "")
+                ("huge-pages", "")
+                ("checksum", "")
+                ("max-bandwidth", po::value<std::string>()->default_value("0"), "")
+                ("max-opens", po::value<std::uint64_t>()->default_value(0), "")
+                ("limits-file", po::value<std::string>(), "");
 
             po::positional_options_description pod;
             pod.add("logical_path", 1);
@@ -66,11 +132,60 @@ namespace irods::cli
                 return 1;
             }
 
-            if ("-" != vm["physical_path"].as<std::string>()) {
-                std::cerr << "Error: Physical path must be '-'.\n";
+            failures_ = 0;
+
+            get_options opts;
+            opts.tuning.connections = vm["connections"].as<int>();
+            opts.tuning.link_speed_gbps = vm["link-speed"].as<double>();
+            opts.retry.retries = std::max(vm["retries"].as<int>(), 0);
+            opts.read_ahead = std::max(vm["read-ahead"].as<int>(), 0);
+            opts.buffer_count = std::max(vm["buffer-count"].as<int>(), 2);
+            opts.checksum = vm.count("checksum") > 0;
+            opts.pool_size = std::max(vm["connection_pool_size"].as<int>(), 1);
+
+            if (vm.count("chunk-size")) {
+                const auto chunk_size = parse_byte_size(vm["chunk-size"].as<std::string>());
+
+                if (!chunk_size || *chunk_size == 0) {
+                    std::cerr << "Error: Invalid chunk size.\n";
+                    return 1;
+                }
+
+                opts.tuning.chunk_size = *chunk_size;
+            }
+
+            if (const auto buffer_size = parse_byte_size(vm["buffer-size"].as<std::string>()); buffer_size && *buffer_size > 0) {
+                opts.buffer_size = *buffer_size;
+            }
+            else {
+                std::cerr << "Error: Invalid buffer size.\n";
+                return 1;
+            }
+
+            if (const auto memory_limit = parse_byte_size(vm["memory-limit"].as<std::string>()); memory_limit) {
+                buffer_pool::instance().configure(*memory_limit, vm.count("huge-pages") > 0);
+            }
+            else {
+                std::cerr << "Error: Invalid memory limit.\n";
                 return 1;
             }
 
+            if (const auto rate = parse_byte_size(vm["max-bandwidth"].as<std::string>()); rate) {
+                limits_.bandwidth.set_rate(*rate);
+            }
+            else {
+                std::cerr << "Error: Invalid bandwidth limit.\n";
+                return 1;
+            }
+
+            limits_.opens.set_rate(vm["max-opens"].as<std::uint64_t>());
+
+            std::optional<limits_file_watcher> watcher;
+
+            if (vm.count("limits-file")) {
+                watcher.emplace(vm["limits-file"].as<std::string>(), limits_);
+            }
+
             rodsEnv env;
 
             if (getRodsEnv(&env) < 0) {
@@ -79,30 +194,773 @@ namespace irods::cli
             }
 
             const auto logical_path = vm["logical_path"].as<std::string>();
-            irods::connection_pool conn_pool{1, env.rodsHost, env.rodsPort, env.rodsUserName, env.rodsZone, 600};
 
-            if (!fs::is_data_object(conn_pool.get_connection(), logical_path)) {
-                std::cerr << "Error: Logical path does not point to a data object.\n";
+            try {
+                irods::connection_pool conn_pool{1, env.rodsHost, env.rodsPort, env.rodsUserName, env.rodsZone, 600};
+
+                if (vm.count("recursive")) {
+                    if (!fs::is_collection(conn_pool.get_connection(), logical_path)) {
+                        std::cerr << "Error: Logical path does not point to a collection.\n";
+                        return 1;
+                    }
+
+                    return get_collection(env, logical_path, vm["physical_path"].as<std::string>(), opts);
+                }
+
+                if (!fs::is_data_object(conn_pool.get_connection(), logical_path)) {
+                    std::cerr << "Error: Logical path does not point to a data object.\n";
+                    return 1;
+                }
+
+                if (const auto& physical_path = vm["physical_path"].as<std::string>(); physical_path != "-") {
+                    return get_file(env, conn_pool, logical_path, physical_path, opts);
+                }
+
+                return get_to_stdout(env, conn_pool, logical_path, opts);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << '\n';
                 return 1;
             }
+        }
+
+    private:
+        struct get_options
+        {
+            transfer_tuning tuning;
+            retry_policy retry;
+            int read_ahead = 0;
+            int buffer_count = 4;
+            std::uint64_t buffer_size = 4 * mebibyte;
+            bool checksum = false;
+            int pool_size = 4;
+        };
+
+        // One data object of a collection download.
+        struct object_task
+        {
+            std::string from;
+            std::string to;
+            std::uint64_t size = 0;
+        };
+
+        // What the helpers of a large download need to join it.
+        struct local_target
+        {
+            int fd = -1;
+            std::shared_ptr<digest_sequencer> digest;
+        };
+
+        using scheduler_type = transfer_scheduler<object_task, local_target>;
+
+        // A stream reading one data object over a connection from a pool. After
+        // a failure it is reopened on a new connection, since the old one may be
+        // broken.
+        class object_stream
+        {
+        public:
+            object_stream(irods::connection_pool& _cpool, const std::string& _path, rate_limiter& _opens)
+                : cpool_{_cpool}
+                , path_{_path}
+                , opens_{_opens}
+            {
+            }
+
+            auto open(bool _reconnect) -> io::idstream&
+            {
+                if (in_ && !_reconnect) {
+                    return *in_;
+                }
+
+                in_.reset();
+                tp_.reset();
+
+                if (conn_) {
+                    if (auto* comm = conn_->release(); comm) {
+                        rcDisconnect(comm);
+                    }
+
+                    conn_.reset();
+                }
 
-            auto conn = conn_pool.get_connection();
+                conn_.emplace(cpool_.get_connection());
+                tp_.emplace(*conn_);
+                opens_.acquire(1);
+                in_.emplace(*tp_, path_);
+
+                if (!*in_) {
+                    throw std::runtime_error{"Cannot open data object for reading [path: " + path_ + "]."};
+                }
+
+                return *in_;
+            }
+
+        private:
+            irods::connection_pool& cpool_;
+            const std::string& path_;
+            rate_limiter& opens_;
+
+            std::optional<irods::connection_pool::connection_proxy> conn_;
+            std::optional<io::client::default_transport> tp_;
+            std::optional<io::idstream> in_;
+        }; // class object_stream
+
+        // Errors reported by the transfer threads of the current command.
+        std::atomic<int> failures_{0};
+
+        auto report_error(const std::exception& _e) -> void
+        {
+            ++failures_;
+            std::cerr << "Error: " << _e.what() << '\n';
+        }
+
+        // The bytes a digest may hold back while waiting for earlier chunks.
+        static auto reorder_limit(std::uint64_t _chunk_size, int _streams) -> std::size_t
+        {
+            return static_cast<std::size_t>(std::min<std::uint64_t>(_chunk_size * static_cast<std::uint64_t>(std::max(_streams, 1)), 256 * mebibyte));
+        }
+
+        static auto verify_download(rcComm_t& _comm, const std::string& _from, const std::string& _digest) -> void
+        {
+            if (!verify_checksum(_comm, _from, _digest)) {
+                std::cerr << "Warning: The data object has no SHA-256 checksum and the zone does not use SHA-256; "
+                             "the download cannot be verified [path: "
+                          << _from << "].\n";
+            }
+        }
+
+        auto get_to_stdout(const rodsEnv& _env,
+                           irods::connection_pool& _cpool,
+                           const std::string& _from,
+                           const get_options& _options) -> int
+        {
+            const auto size = fs::data_object_size(_cpool.get_connection(), _from);
+            auto streams = _options.read_ahead;
+
+            if (streams == 0) {
+                const auto plan = make_transfer_plan(size, _options.tuning);
+                streams = plan.parallel ? plan.connections : 1;
+            }
+
+            if (streams > 1 && size > 0) {
+                return get_to_stdout_ordered(_env, _from, size, streams, _options);
+            }
+
+            auto conn = _cpool.get_connection();
             io::client::default_transport dtp{conn};
+            limits_.opens.acquire(1);
+
+            io::idstream in{dtp, _from};
+
+            if (!in) {
+                std::cerr << "Error: Could not open input stream [path => " << _from << "]\n";
+                return 1;
+            }
+
+            // The server is read on its own thread, so the download and the
+            // writes to stdout keep moving at the same time.
+            buffer_ring ring{static_cast<std::size_t>(_options.buffer_count), _options.buffer_size};
+            std::optional<sha256_digest> digest;
+
+            if (_options.checksum) {
+                digest.emplace();
+            }
+
+            // A read error looks like the end of the stream, so the bytes
+            // received are held against the size of the data object.
+            std::uint64_t received = 0;
+
+            pipe_through(
+                ring,
+                [this, &in, &received, size, &_from](buffer_ring::slot& _slot) {
+                    in.read(_slot.buffer.data(), static_cast<std::streamsize>(_slot.buffer.size()));
+                    _slot.size = static_cast<std::size_t>(in.gcount());
+                    limits_.bandwidth.acquire(_slot.size);
+                    received += _slot.size;
+
+                    if (!in && (in.bad() || received != size)) {
+                        throw std::runtime_error{"The download is incomplete [path: " + _from + "]."};
+                    }
+
+                    return static_cast<bool>(in);
+                },
+                [&digest](const buffer_ring::slot& _slot) {
+                    if (std::fwrite(_slot.buffer.data(), 1, _slot.size, stdout) != _slot.size) {
+                        throw std::runtime_error{"Cannot write to stdout."};
+                    }
+
+                    if (digest) {
+                        digest->update(_slot.buffer.data(), _slot.size);
+                    }
+                });
+
+            std::fflush(stdout);
+
+            if (digest) {
+                in.close();
+                verify_download(conn, _from, digest->finish());
+            }
+
+            return 0;
+        }
+
+        // Streams a data object to stdout over several connections, so that a
+        // pipe is fed at multi-stream speed. Each connection fetches whole ranges
+        // ahead of the writer and a range_window puts them back in order; at
+        // most one range per connection is held at a time.
+        auto get_to_stdout_ordered(const rodsEnv& _env,
+                                   const std::string& _from,
+                                   std::uint64_t _size,
+                                   int _streams,
+                                   const get_options& _options) -> int
+        {
+            // Ranges are fetched with one read each, so they are kept fairly
+            // large; on a slow link a small range is dominated by the seek.
+            const auto range_size = _options.tuning.chunk_size > 0 ? _options.tuning.chunk_size : 16 * mebibyte;
+
+            chunk_scheduler ranges{_size, range_size};
+            const auto streams = static_cast<int>(std::min<std::uint64_t>(_streams, ranges.chunk_count()));
+
+            range_window window{static_cast<std::size_t>(streams), static_cast<std::size_t>(range_size), ranges.chunk_count()};
+            irods::connection_pool cpool{streams, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+            irods::thread_pool tpool{streams};
+
+            for (int i = 0; i < streams; ++i) {
+                irods::thread_pool::post(tpool, [&] {
+                    try {
+                        fetch_ranges(cpool, ranges, window, _from, _options);
+                    }
+                    catch (const std::exception& e) {
+                        report_error(e);
+                        window.cancel();
+                    }
+                });
+            }
+
+            std::optional<sha256_digest> digest;
+
+            if (_options.checksum) {
+                digest.emplace();
+            }
 
-            if (io::idstream in{dtp, logical_path}; in) {
-                std::array<char, 4 * 1024 * 1024> buffer{};
+            try {
+                while (auto* s = window.next()) {
+                    if (std::fwrite(s->buffer.data(), 1, s->size, stdout) != s->size) {
+                        throw std::runtime_error{"Cannot write to stdout."};
+                    }
 
-                while (in && std::cout) {
-                    in.read(&buffer[0], buffer.size());
-                    std::cout.write(&buffer[0], in.gcount());
+                    if (digest) {
+                        digest->update(s->buffer.data(), s->size);
+                    }
+
+                    window.release(s);
                 }
             }
-            else {
-                std::cerr << "Error: Could not open input stream [path => " << logical_path << "]\n";
+            catch (...) {
+                window.cancel();
+                tpool.join();
+                throw;
+            }
+
+            tpool.join();
+            std::fflush(stdout);
+
+            if (failures_ > 0) {
+                std::cerr << "Error: The download is incomplete [path: " << _from << "].\n";
+                return 1;
+            }
+
+            if (digest) {
+                verify_download(cpool.get_connection(), _from, digest->finish());
+            }
+
+            return 0;
+        }
+
+        // Claims ranges in ascending order and reads each into its buffer of the
+        // window. A range that fails is fetched again after a backoff, on a new
+        // connection, up to the retry budget.
+        auto fetch_ranges(irods::connection_pool& _cpool,
+                          chunk_scheduler& _ranges,
+                          range_window& _window,
+                          const std::string& _from,
+                          const get_options& _options) -> void
+        {
+            object_stream stream{_cpool, _from, limits_.opens};
+
+            while (const auto range = _ranges.next()) {
+                auto* s = _window.acquire(range->index);
+
+                if (!s) {
+                    return;
+                }
+
+                for (int attempt = 0;; ++attempt) {
+                    try {
+                        auto& source = stream.open(attempt > 0);
+
+                        if (!source.seekg(static_cast<std::streamoff>(range->offset))) {
+                            throw std::runtime_error{"Seek failed [path: " + _from + "]."};
+                        }
+
+                        source.read(s->buffer.data(), static_cast<std::streamsize>(range->size));
+
+                        if (static_cast<std::uint64_t>(source.gcount()) != range->size) {
+                            throw std::runtime_error{"Short read [path: " + _from + "]."};
+                        }
+
+                        break;
+                    }
+                    catch (const std::exception& e) {
+                        if (attempt >= _options.retry.retries) {
+                            throw;
+                        }
+
+                        std::cerr << "Warning: " << e.what() << " Retrying range " << range->index << " [path: "
+                                  << _from << "].\n";
+                        std::this_thread::sleep_for(_options.retry.delay(attempt));
+                    }
+                }
+
+                limits_.bandwidth.acquire(range->size);
+                _window.fill(s, static_cast<std::size_t>(range->size));
+            }
+        }
+
+        // Downloads a data object into a local file. The file is allocated at its
+        // final size up front, which keeps it from fragmenting and fails early
+        // if the disk is too small. The object is then cut into ranges that
+        // several connections fetch and write straight to their offsets, the
+        // same way large files are uploaded. A download that fails is removed,
+        // since a preallocated file with holes would look complete.
+        auto get_file(const rodsEnv& _env,
+                      irods::connection_pool& _cpool,
+                      const std::string& _from,
+                      std::string _to,
+                      const get_options& _options) -> int
+        {
+            if (struct stat st; ::stat(_to.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                _to += '/' + ifs::path{_from}.object_name().string();
+            }
+
+            const auto size = fs::data_object_size(_cpool.get_connection(), _from);
+            const auto plan = make_transfer_plan(size, _options.tuning);
+
+            auto fd = -1;
+            bool created = false;
+
+            try {
+                fd = open_local(_to, size);
+                created = true;
+
+                chunk_scheduler scheduler{size, plan.parallel ? plan.chunk_size : size};
+                std::unique_ptr<digest_sequencer> digest;
+
+                if (_options.checksum) {
+                    digest = std::make_unique<digest_sequencer>(reorder_limit(scheduler.chunk_size(), plan.connections));
+                }
+
+                const auto fetch = [&](irods::connection_pool& _pool) {
+                    try {
+                        get_chunks(_pool, scheduler, _from, fd, _to, _options, digest.get());
+                    }
+                    catch (const std::exception& e) {
+                        report_error(e);
+                    }
+                };
+
+                if (!plan.parallel) {
+                    fetch(_cpool);
+                }
+                else {
+                    irods::connection_pool cpool{plan.connections, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+                    irods::thread_pool tpool{plan.connections};
+
+                    for (int i = 0; i < plan.connections; ++i) {
+                        irods::thread_pool::post(tpool, [&] { fetch(cpool); });
+                    }
+
+                    tpool.join();
+                }
+
+                if (::close(std::exchange(fd, -1)) != 0) {
+                    throw std::runtime_error{"Cannot close local file [path: " + _to + ", error: " + std::strerror(errno) + "]."};
+                }
+
+                if (!scheduler.all_done()) {
+                    throw std::runtime_error{"The download is incomplete [path: " + _to + "]."};
+                }
+
+                if (digest) {
+                    if (const auto d = digest->finish(size); d) {
+                        verify_download(_cpool.get_connection(), _from, *d);
+                    }
+                }
+            }
+            catch (const std::exception& e) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+
+                if (created) {
+                    ::unlink(_to.c_str());
+                }
+
+                std::cerr << "Error: " << e.what() << '\n';
+                return 1;
             }
 
             return 0;
         }
+
+        // Creates (or truncates) a local file and allocates it at its final size.
+        static auto open_local(const std::string& _path, std::uint64_t _size) -> int
+        {
+            const auto fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+
+            if (fd < 0) {
+                throw std::runtime_error{"Cannot open local file [path: " + _path + ", error: " + std::strerror(errno) + "]."};
+            }
+
+            try {
+                preallocate(fd, _path, _size);
+            }
+            catch (...) {
+                ::close(fd);
+                ::unlink(_path.c_str());
+                throw;
+            }
+
+            return fd;
+        }
+
+        // Reserves the blocks of the whole file. File systems that cannot do so
+        // only get the size set.
+        static auto preallocate(int _fd, const std::string& _path, std::uint64_t _size) -> void
+        {
+            if (_size == 0) {
+                return;
+            }
+
+            if (::fallocate(_fd, 0, 0, static_cast<off_t>(_size)) == 0) {
+                return;
+            }
+
+            if ((errno == EOPNOTSUPP || errno == ENOSYS) && ::ftruncate(_fd, static_cast<off_t>(_size)) == 0) {
+                return;
+            }
+
+            throw std::runtime_error{"Cannot allocate local file [path: " + _path + ", error: " + std::strerror(errno) + "]."};
+        }
+
+        // Claims ranges from the shared scheduler and fetches each over one
+        // connection, writing the bytes to the same offset of the local file.
+        // Local writes run in the background while the next bytes arrive.
+        //
+        // A range that fails is fetched again after a backoff, on a new
+        // connection since the old one may be broken, up to the retry budget.
+        // Ranges are marked done in the scheduler once their bytes are on disk.
+        auto get_chunks(irods::connection_pool& _cpool,
+                        chunk_scheduler& _scheduler,
+                        const std::string& _from,
+                        int _fd,
+                        const std::string& _to,
+                        const get_options& _options,
+                        digest_sequencer* _digest) -> void
+        {
+            // The buffers must be in hand before a range is claimed; see buffer_pool.
+            async_writer writer{_fd, static_cast<std::size_t>(_options.buffer_size), 2, io_backend::automatic};
+
+            object_stream stream{_cpool, _from, limits_.opens};
+            std::vector<chunk> fetched;
+
+            try {
+                while (const auto chunk = _scheduler.next()) {
+                    for (int attempt = 0;; ++attempt) {
+                        try {
+                            auto& source = stream.open(attempt > 0);
+
+                            if (!source.seekg(static_cast<std::streamoff>(chunk->offset))) {
+                                throw std::runtime_error{"Seek failed [path: " + _from + "]."};
+                            }
+
+                            for (auto pos = chunk->offset; pos < chunk->offset + chunk->size;) {
+                                auto& buffer = writer.acquire();
+                                const auto n = std::min<std::uint64_t>(buffer.size(), chunk->offset + chunk->size - pos);
+
+                                source.read(buffer.data(), static_cast<std::streamsize>(n));
+
+                                if (static_cast<std::uint64_t>(source.gcount()) != n) {
+                                    throw std::runtime_error{"Short read [path: " + _from + "]."};
+                                }
+
+                                limits_.bandwidth.acquire(n);
+
+                                if (_digest) {
+                                    _digest->feed(pos, buffer.data(), static_cast<std::size_t>(n));
+                                }
+
+                                writer.submit(static_cast<std::size_t>(n), static_cast<std::int64_t>(pos));
+                                pos += n;
+                            }
+
+                            break;
+                        }
+                        catch (const std::exception& e) {
+                            if (attempt >= _options.retry.retries) {
+                                throw;
+                            }
+
+                            std::cerr << "Warning: " << e.what() << " Retrying range " << chunk->index << " [path: "
+                                      << _to << "].\n";
+                            std::this_thread::sleep_for(_options.retry.delay(attempt));
+                        }
+                    }
+
+                    fetched.push_back(*chunk);
+                }
+
+                writer.flush();
+
+                for (auto&& c : fetched) {
+                    _scheduler.mark_done(c);
+                }
+            }
+            catch (const std::exception&) {
+                if (_digest) {
+                    _digest->abandon();
+                }
+
+                throw;
+            }
+        }
+
+        // Downloads a collection and everything below it. The tree is found
+        // with two paged GenQueries (one for the collections, one for the data
+        // objects) rather than by listing each collection in turn, and is fed
+        // to the workers while they run. Small data objects are fetched whole,
+        // several at a time; large ones are cut into ranges that idle workers
+        // join. The scheduler bounds how far the queries run ahead, so memory
+        // stays flat however large the collection is.
+        auto get_collection(const rodsEnv& _env,
+                            std::string _from,
+                            const std::string& _to,
+                            const get_options& _options) -> int
+        {
+            while (_from.size() > 1 && _from.back() == '/') {
+                _from.pop_back();
+            }
+
+            if (!queryable(_from)) {
+                std::cerr << "Error: Collection names containing quotes cannot be downloaded [path: " << _from << "].\n";
+                return 1;
+            }
+
+            // Like cp -r: an existing directory receives the collection, any
+            // other path becomes its copy.
+            auto root = _to;
+
+            if (boost::system::error_code ec; bfs::is_directory(_to, ec) && _from != "/") {
+                root += '/' + ifs::path{_from}.object_name().string();
+            }
+
+            // Paths below the collection are appended to the root as they are.
+            const auto base = _from == "/" ? std::string{} : _from;
+            const auto local_path = [&](const std::string& _collection) {
+                return root + _collection.substr(base.size());
+            };
+
+            // One connection more than there are workers, for the feeder.
+            const auto workers = _options.pool_size;
+            irods::connection_pool cpool{workers + 1, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+
+            scheduler_type scheduler{workers};
+            irods::thread_pool thread_pool{workers + 1};
+
+            irods::thread_pool::post(thread_pool, [&] {
+                try {
+                    auto conn = cpool.get_connection();
+
+                    // Parents come first, so every directory exists before a file
+                    // is written into it.
+                    for_each_collection_under(conn, _from, [&](const std::string& _collection) {
+                        bfs::create_directories(local_path(_collection));
+                    });
+
+                    for_each_data_object_under(
+                        conn,
+                        _from,
+                        [&](const std::string& _collection, const std::string& _name, std::uint64_t _size) {
+                            object_task task{_collection + '/' + _name, local_path(_collection) + '/' + _name, _size};
+
+                            if (const auto plan = make_transfer_plan(_size, _options.tuning); plan.parallel) {
+                                scheduler.add_large(std::move(task), _size, plan.chunk_size, plan.connections);
+                            }
+                            else {
+                                scheduler.add_small(std::move(task));
+                            }
+                        },
+                        [&](const std::string& _collection, const std::string& _name) {
+                            ++failures_;
+                            std::cerr << "Warning: The data object has no good replica and was skipped [path: "
+                                      << _collection << '/' << _name << "].\n";
+                        });
+                }
+                catch (const std::exception& e) {
+                    report_error(e);
+                }
+
+                scheduler.close();
+            });
+
+            for (int i = 0; i < workers; ++i) {
+                irods::thread_pool::post(thread_pool, [&] {
+                    download_worker(cpool, scheduler, _options);
+                });
+            }
+
+            thread_pool.join();
+
+            return failures_ > 0 ? 1 : 0;
+        }
+
+        auto download_worker(irods::connection_pool& _cpool, scheduler_type& _scheduler, const get_options& _options)
+            -> void
+        {
+            while (auto work = _scheduler.next()) {
+                switch (work->kind) {
+                    case scheduler_type::work_kind::small:
+                        get_small_object(_cpool, work->task, _options);
+                        _scheduler.complete_small();
+                        break;
+
+                    case scheduler_type::work_kind::lead:
+                        lead_large_object(_cpool, _scheduler, work->large, _options);
+                        break;
+
+                    case scheduler_type::work_kind::join:
+                        try {
+                            get_chunks(_cpool,
+                                       work->large->chunks,
+                                       work->large->task.from,
+                                       work->large->context.fd,
+                                       work->large->task.to,
+                                       _options,
+                                       work->large->context.digest.get());
+                        }
+                        catch (const std::exception& e) {
+                            report_error(e);
+                        }
+
+                        _scheduler.leave(work->large);
+                        break;
+                }
+            }
+        }
+
+        auto get_small_object(irods::connection_pool& _cpool, const object_task& _task, const get_options& _options)
+            -> void
+        {
+            auto fd = -1;
+            bool created = false;
+
+            try {
+                fd = open_local(_task.to, _task.size);
+                created = true;
+
+                chunk_scheduler chunks{_task.size, _task.size};
+                std::unique_ptr<digest_sequencer> digest;
+
+                if (_options.checksum) {
+                    digest = std::make_unique<digest_sequencer>(reorder_limit(chunks.chunk_size(), 1));
+                }
+
+                get_chunks(_cpool, chunks, _task.from, fd, _task.to, _options, digest.get());
+
+                if (::close(std::exchange(fd, -1)) != 0) {
+                    throw std::runtime_error{"Cannot close local file [path: " + _task.to + ", error: " + std::strerror(errno) + "]."};
+                }
+
+                if (digest) {
+                    if (const auto d = digest->finish(_task.size); d) {
+                        verify_download(_cpool.get_connection(), _task.from, *d);
+                    }
+                }
+            }
+            catch (const std::exception& e) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+
+                if (created) {
+                    ::unlink(_task.to.c_str());
+                }
+
+                report_error(e);
+            }
+        }
+
+        auto lead_large_object(irods::connection_pool& _cpool,
+                               scheduler_type& _scheduler,
+                               const scheduler_type::large_pointer& _large,
+                               const get_options& _options) -> void
+        {
+            const auto& [from, to, size] = _large->task;
+            auto& context = _large->context;
+
+            bool created = false;
+
+            try {
+                context.fd = open_local(to, size);
+                created = true;
+
+                if (_options.checksum) {
+                    context.digest = std::make_shared<digest_sequencer>(reorder_limit(_large->chunks.chunk_size(), _options.pool_size));
+                }
+
+                _scheduler.publish(_large);
+
+                try {
+                    get_chunks(_cpool, _large->chunks, from, context.fd, to, _options, context.digest.get());
+                }
+                catch (const std::exception& e) {
+                    report_error(e);
+                }
+
+                // The helpers write to the same descriptor.
+                _scheduler.wait_for_helpers(_large);
+
+                if (::close(std::exchange(context.fd, -1)) != 0) {
+                    throw std::runtime_error{"Cannot close local file [path: " + to + ", error: " + std::strerror(errno) + "]."};
+                }
+
+                if (!_large->chunks.all_done()) {
+                    throw std::runtime_error{"The download is incomplete [path: " + to + "]."};
+                }
+
+                if (const auto& digest = context.digest; digest) {
+                    if (const auto d = digest->finish(size); d) {
+                        verify_download(_cpool.get_connection(), from, *d);
+                    }
+                }
+            }
+            catch (const std::exception& e) {
+                if (context.fd >= 0) {
+                    ::close(std::exchange(context.fd, -1));
+                }
+
+                if (created) {
+                    ::unlink(to.c_str());
+                }
+
+                report_error(e);
+            }
+
+            _scheduler.finish(_large);
+        }
+
+        // Shared by every stream of the current command.
+        transfer_limits limits_;
     }; // class get
 } // namespace irods::cli
 
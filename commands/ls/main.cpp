@@ -1,4 +1,8 @@
 #include "command.hpp"
+#include "collection_listing.hpp"
+#include "collection_traverser.hpp"
+#include "listing_format.hpp"
+#include "listing_writer.hpp"
 
 #include <irods/rodsClient.h>
 #include <irods/connection_pool.hpp>
@@ -30,39 +34,26 @@ namespace po = boost::program_options;
 
 namespace irods::cli
 {
-    auto getAclString(rcComm_t& conn, const fs::client::collection_entry& ce) -> std::string 
+    // The ACL line printed below an entry.
+    auto write_acls(listing_writer& out, const std::vector<std::string>* entries) -> void
     {
-        bool didUseSpecificQuery = false;
-        std::stringstream ss, os;
-        os << "        ACL - ";
-        auto _path = ce.path();
-        if(ce.is_data_object()) {
-            ss << "SELECT USER_NAME, DATA_ACCESS_NAME WHERE COLL_NAME = '";
-            ss << _path.parent_path().string() << "' AND DATA_NAME = '" << _path.object_name().string() << "'";
-        }
-        else {
-            try {
-                std::vector<std::string> testArgs;
-                testArgs.push_back(_path.string());
-                for (auto&& row : irods::query<rcComm_t>(&conn, "ShowCollAcls", &testArgs, {}, 0, 0, irods::query<rcComm_t>::SPECIFIC, 0)) {
-                    os << row.at(0) << "|" << row.at(1) << "|" << row.at(2);
-                }
-                didUseSpecificQuery = true;
-            } 
-            catch(const irods::exception& e) {
-                std::cout << "reached exception block\n";
-                ss << "SELECT COLL_USER_NAME, COLL_ACCESS_NAME WHERE COLL_NAME = '";
-                ss << _path.string() << "'";
-            }
-        }
-        if(!didUseSpecificQuery) {
-            for (auto&& row : irods::query<rcComm_t>{&conn, ss.str()}) {
-                os << "    " << row.at(0) << "#" << row.at(1);
+        out.write("        ACL - ");
+        if(entries) {
+            for(auto&& e : *entries) {
+                out.write("    ");
+                out.write(e);
             }
         }
-        os << "\n";
-        return os.str();
+        out.write("\n");
+    }
+
+    // Returns nullptr if nobody has access.
+    auto find_acls(const std::unordered_map<std::string, std::vector<std::string>>& acls, const std::string& key) -> const std::vector<std::string>*
+    {
+        const auto it = acls.find(key);
+        return it == acls.end() ? nullptr : &it->second;
     }
+
     inline auto canonical(const std::string_view _path, const rodsEnv& _env) -> std::optional<std::string>
     {
         rodsPath_t input{};
@@ -106,6 +97,9 @@ namespace irods::cli
                 ("r,r", "")
                 ("t,t", po::value<std::string>(), "")
                 ("bundle", "")
+                ("ordered", "")
+                ("format", po::value<std::string>()->default_value("text"), "")
+                ("connection_pool_size,c", po::value<int>()->default_value(8), "")
                 ("logical_path", po::value<std::string>(), "");
 
             po::positional_options_description positional_options;
@@ -133,7 +127,10 @@ namespace irods::cli
             else {
                 logical_path = env.rodsCwd;
             }
-            auto conn_pool = irods::make_connection_pool();
+
+            // Recursive listings take one connection per traversal thread, on top of this one.
+            const auto threads = vm.count("r") ? std::max(vm["connection_pool_size"].as<int>(), 1) : 0;
+            auto conn_pool = irods::make_connection_pool(threads + 1);
             auto conn = conn_pool->get_connection();
 
             const auto s = fs::client::status(conn, logical_path);
@@ -142,95 +139,329 @@ namespace irods::cli
                 return 1;
             }
 
-            //default behavior: just print name
-            auto printFuncPtr = &CLI_COMMAND_NAME::print_short_description;
+            listing_options opts;
+            opts.long_format = vm.count("l") || vm.count("L");
+            opts.details = vm.count("L") > 0;
+            opts.acls = vm.count("acls") > 0;
 
-            if(vm.count("L")) {
-                printFuncPtr = &CLI_COMMAND_NAME::print_multi_line_description;
+            if(const auto format = parse_listing_format(vm["format"].as<std::string>()); format) {
+                opts.format = *format;
             }
-            else if(vm.count("l")) {
-                printFuncPtr = &CLI_COMMAND_NAME::print_one_liner_description;
+            else {
+                std::cerr << "Error: Invalid format. Expected text, jsonl, nul or tsv.\n";
+                return 1;
             }
-            //std::bind lame :(
-            auto const printfunc = std::bind(printFuncPtr, this, std::placeholders::_1, std::placeholders::_2);
-            if(vm.count("r")) {
-                for(auto&& e : fs::client::recursive_collection_iterator{conn,logical_path}) {
-                    std::invoke(printfunc, conn, e);
-                    if(vm.count("acls")) {
-                        std::cout << getAclString(conn, e);
-                    }
-                }
+
+            if(fs::client::is_data_object(s)) {
+                list_data_object(conn, logical_path, opts);
+            }
+            else if(!vm.count("r")) {
+                list_collection(conn, out_, logical_path, opts, nullptr);
             }
             else {
-                for(auto&& e : fs::client::collection_iterator{conn,logical_path}) {
-                    std::invoke(printfunc, conn, e);
-                    if(vm.count("acls")) {
-                        std::cout << getAclString(conn, e);
-                    }
+                // Each collection becomes a block headed by its path. The
+                // blocks arrive as the collections are listed, or in a fixed
+                // depth-first order with --ordered.
+                collection_traverser traverser{*conn_pool, threads, vm.count("ordered") > 0};
+                const auto failures = traverser.run(logical_path,
+                    [this, &opts](rcComm_t& c, collection_block& b) {
+                        if(opts.format == listing_format::text) {
+                            b.out.print("{}:\n", b.collection);
+                            list_collection(c, b.out, b.collection, opts, &b.subcollections);
+                            b.out.write("\n");
+                        }
+                        else {
+                            list_collection(c, b.out, b.collection, opts, &b.subcollections);
+                        }
+                    },
+                    [this](std::string_view text) {
+                        out_.write(text);
+                    });
+                if(failures > 0) {
+                    out_.flush();
+                    return 1;
                 }
             }
 
+            out_.flush();
             return 0;
         }
 
     private:
-        auto print_short_description(rcComm_t& conn, const fs::client::collection_entry& e) -> void
+        struct listing_options
         {
-            std::stringstream os;
-            if(!e.is_data_object()) {
-                os << "C- ";
+            bool long_format = false;
+            bool details = false;
+            bool acls = false;
+            listing_format format = listing_format::text;
+
+            auto columns() const noexcept -> listing_columns
+            {
+                return {long_format, details, acls};
+            }
+        };
+
+        static auto replica_row(const replica_info& r, std::string_view path, bool details) -> listing_row
+        {
+            listing_row row;
+            row.type = "data_object";
+            row.path = path;
+            row.owner = r.owner;
+            row.replica = r.number;
+            row.resource = r.resource;
+            row.size = r.size;
+            row.modify_time = r.modify_time;
+            row.good = r.good;
+            if(details) {
+                row.checksum = r.checksum;
+                row.physical_path = r.physical_path;
+            }
+            return row;
+        }
+
+        // One line per replica, marked '&' if it is good. With details (-L), a
+        // second line holds the checksum and the physical path.
+        static auto print_replica(listing_writer& out, const replica_info& r, bool details) -> void
+        {
+            out.print("{:<10} {} {:<10} {:>15} {} {} {}\n",
+                      r.owner,
+                      r.number,
+                      r.resource,
+                      r.size,
+                      out.timestamp(r.modify_time),
+                      r.good ? '&' : ' ',
+                      r.name);
+            if(details) {
+                out.print("    {:<50} {}\n", r.checksum, r.physical_path);
+            }
+        }
+
+        // -l, -L and -A are served by GenQuery, which cannot name paths
+        // containing quotes; only the names of those are listed.
+        static auto warn_names_only(const std::string& path, const listing_options& opts) -> void
+        {
+            if(opts.long_format || opts.acls) {
+                std::cerr << "Warning: Only names can be listed for paths containing quotes [path: " << path << "].\n";
+            }
+        }
+
+        auto list_data_object(rcComm_t& conn, const std::string& logical_path, const listing_options& opts) -> void
+        {
+            const fs::path path = logical_path;
+            const auto parent = path.parent_path().string();
+            const auto name = path.object_name().string();
+
+            if(!queryable(logical_path)) {
+                warn_names_only(logical_path, opts);
+                if(opts.format == listing_format::text) {
+                    out_.print("{}\n", name);
+                }
+                else {
+                    listing_row row;
+                    row.type = "data_object";
+                    row.path = logical_path;
+                    write_row(out_, opts.format, opts.columns(), row);
+                }
+                return;
+            }
+
+            collection_acls acls;
+            if(opts.acls) {
+                acls = list_acls(conn, parent, name);
+            }
+
+            if(opts.format != listing_format::text) {
+                const auto* entries = find_acls(acls.data_objects, name);
+                if(opts.long_format) {
+                    for_each_replica_in(conn, parent, opts.details, [&](const replica_info& r) {
+                        auto row = replica_row(r, logical_path, opts.details);
+                        row.acls = entries;
+                        write_row(out_, opts.format, opts.columns(), row);
+                    }, name);
+                }
+                else {
+                    listing_row row;
+                    row.type = "data_object";
+                    row.path = logical_path;
+                    row.acls = entries;
+                    write_row(out_, opts.format, opts.columns(), row);
+                }
+                return;
+            }
+
+            if(opts.long_format) {
+                for_each_replica_in(conn, parent, opts.details, [&](const replica_info& r) {
+                    print_replica(out_, r, opts.details);
+                }, name);
+            }
+            else {
+                out_.print("{}\n", name);
+            }
+            if(opts.acls) {
+                write_acls(out_, find_acls(acls.data_objects, name));
             }
-            os << e.path().object_name().c_str() << "\n";
-            std::cout << os.str();
         }
-        auto print_one_liner_description(rcComm_t& conn, const fs::client::collection_entry& e) -> void
+
+        // The data objects of a collection, then its subcollections, whose
+        // paths are added to subcollections if given. Costs a few paged
+        // queries per collection, however many entries it holds, and only one
+        // of them is open at a time. May run on several threads at once.
+        static auto list_collection(rcComm_t& conn,
+                                    listing_writer& out,
+                                    const std::string& collection,
+                                    const listing_options& opts,
+                                    std::vector<std::string>* subcollections) -> void
         {
-            auto tm = std::chrono::system_clock::to_time_t(e.last_write_time());
-            std::stringstream ss;
-            ss << std::put_time(std::localtime(&tm), "%F %T");
-            if(e.is_data_object()) {
-                fmt::print("{:<10} {} {:<10} {:>15} {} & {}\n",
-                           e.owner(),
-                           0,
-                           "demoResc",
-                           fs::client::data_object_size(conn, e),
-                           ss.str(),
-                           e.path().object_name().c_str());
-            } else {
-                fmt::print("{:<10} {} {:<10} {} & {}\n",
-                           e.owner(),
-                           0,
-                           "demoResc",
-                           ss.str(),
-                           e.path().object_name().c_str());
+            if(!queryable(collection)) {
+                warn_names_only(collection, opts);
+                list_names(conn, out, collection, opts, subcollections);
+                return;
+            }
+
+            collection_acls acls;
+            if(opts.acls) {
+                acls = list_acls(conn, collection);
+            }
 
+            if(opts.format != listing_format::text) {
+                write_collection_rows(conn, out, collection, opts, acls, subcollections);
+                return;
+            }
+
+            if(opts.long_format) {
+                std::string last_name;
+                for_each_replica_in(conn, collection, opts.details, [&](const replica_info& r) {
+                    if(opts.acls && !last_name.empty() && r.name != last_name) {
+                        write_acls(out, find_acls(acls.data_objects, last_name));
+                    }
+                    last_name = r.name;
+                    print_replica(out, r, opts.details);
+                });
+                if(opts.acls && !last_name.empty()) {
+                    write_acls(out, find_acls(acls.data_objects, last_name));
+                }
+            }
+            else {
+                for_each_data_object_in(conn, collection, [&](const std::string& name) {
+                    out.print("{}\n", name);
+                    if(opts.acls) {
+                        write_acls(out, find_acls(acls.data_objects, name));
+                    }
+                });
+            }
+
+            for(auto&& c : list_subcollections(conn, collection)) {
+                const fs::path path = c.path;
+                if(opts.long_format) {
+                    out.print("{:<10} {} C- {}\n", c.owner, out.timestamp(c.modify_time), path.object_name().c_str());
+                }
+                else {
+                    out.print("C- {}\n", path.object_name().c_str());
+                }
+                if(opts.acls) {
+                    write_acls(out, find_acls(acls.collections, c.path));
+                }
+                if(subcollections) {
+                    subcollections->push_back(std::move(c.path));
+                }
             }
         }
 
-        auto print_multi_line_description(rcComm_t& conn, const fs::client::collection_entry& e) -> void
+        // The machine-readable counterpart of list_collection: one row per
+        // entry (per replica in long format), written as the query results
+        // arrive.
+        static auto write_collection_rows(rcComm_t& conn,
+                                          listing_writer& out,
+                                          const std::string& collection,
+                                          const listing_options& opts,
+                                          const collection_acls& acls,
+                                          std::vector<std::string>* subcollections) -> void
         {
-            auto tm = std::chrono::system_clock::to_time_t(e.last_write_time());
-            std::stringstream ss;
-            ss << std::put_time(std::localtime(&tm), "%F %T");
-             if(e.is_data_object()) {
-                fmt::print("{:<10} {} {:<10} {:>15} {} & {}\n",
-                           e.owner(),
-                           0,
-                           "demoResc",
-                           fs::client::data_object_size(conn, e),
-                           ss.str(),
-                           e.path().object_name().c_str());
-            } else {
-                fmt::print("{:<10} {} {:<10} {} & {}\n",
-                           e.owner(),
-                           0,
-                           "demoResc",
-                           ss.str(),
-                           e.path().object_name().c_str());
+            const auto columns = opts.columns();
+            std::string path;
+
+            if(opts.long_format) {
+                for_each_replica_in(conn, collection, opts.details, [&](const replica_info& r) {
+                    join_logical_path(path, collection, r.name);
+                    auto row = replica_row(r, path, opts.details);
+                    if(opts.acls) {
+                        row.acls = find_acls(acls.data_objects, r.name);
+                    }
+                    write_row(out, opts.format, columns, row);
+                });
+            }
+            else {
+                for_each_data_object_in(conn, collection, [&](const std::string& name) {
+                    join_logical_path(path, collection, name);
+                    listing_row row;
+                    row.type = "data_object";
+                    row.path = path;
+                    if(opts.acls) {
+                        row.acls = find_acls(acls.data_objects, name);
+                    }
+                    write_row(out, opts.format, columns, row);
+                });
+            }
 
+            for(auto&& c : list_subcollections(conn, collection)) {
+                listing_row row;
+                row.type = "collection";
+                row.path = c.path;
+                if(opts.long_format) {
+                    row.owner = c.owner;
+                    row.modify_time = c.modify_time;
+                }
+                if(opts.acls) {
+                    row.acls = find_acls(acls.collections, c.path);
+                }
+                write_row(out, opts.format, columns, row);
+                if(subcollections) {
+                    subcollections->push_back(std::move(c.path));
+                }
             }
+        }
+
+        // The names in a collection that GenQuery cannot name, as in the short
+        // format. Rows keep the columns of the other collections, left empty.
+        static auto list_names(rcComm_t& conn,
+                               listing_writer& out,
+                               const std::string& collection,
+                               const listing_options& opts,
+                               std::vector<std::string>* subcollections) -> void
+        {
+            const auto text = opts.format == listing_format::text;
+            std::string path;
+
+            auto subs = for_each_entry_in(conn, collection, [&](const std::string& name) {
+                if(text) {
+                    out.print("{}\n", name);
+                    return;
+                }
+                join_logical_path(path, collection, name);
+                listing_row row;
+                row.type = "data_object";
+                row.path = path;
+                write_row(out, opts.format, opts.columns(), row);
+            });
 
+            for(auto&& c : subs) {
+                if(text) {
+                    out.print("C- {}\n", fs::path{c}.object_name().c_str());
+                }
+                else {
+                    listing_row row;
+                    row.type = "collection";
+                    row.path = c;
+                    write_row(out, opts.format, opts.columns(), row);
+                }
+                if(subcollections) {
+                    subcollections->push_back(std::move(c));
+                }
+            }
         }
+
+        // All listing output goes through here.
+        listing_writer out_;
     }; // class ls
 } // namespace irods::cli
 
@@ -1,4 +1,19 @@
 #include "command.hpp"
+#include "async_io.hpp"
+#include "buffer_pool.hpp"
+#include "buffer_ring.hpp"
+#include "byte_size.hpp"
+#include "chunk_scheduler.hpp"
+#include "collection_cache.hpp"
+#include "collection_listing.hpp"
+#include "local_file.hpp"
+#include "local_walker.hpp"
+#include "manifest_reader.hpp"
+#include "rate_limiter.hpp"
+#include "retry_policy.hpp"
+#include "sha256_digest.hpp"
+#include "transfer_journal.hpp"
+#include "transfer_scheduler.hpp"
 
 #include <irods/rodsClient.h>
 #include <irods/thread_pool.hpp>
@@ -10,6 +25,8 @@
 #include <irods/irods_client_api_table.hpp>
 #include <irods/irods_pack_table.hpp>
 
+#include <sys/stat.h>
+
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/preprocessor/cat.hpp>
@@ -17,7 +34,7 @@
 
 #include <iostream>
 #include <string>
-#include <array>
+#include <cstdio>
 #include <vector>
 #include <memory>
 #include <fstream>
@@ -27,6 +44,8 @@
 #include <mutex>
 #include <atomic>
 #include <algorithm>
+#include <unordered_map>
+#include <cstring>
 
 #define CLI_COMMAND_NAME put
 
@@ -78,7 +97,43 @@ namespace irods::cli
 
         auto help_text() const noexcept -> std::string_view override
         {
-            return "The help text.";
+            auto help = R"(
+Uploads a local file or directory into iRODS. Use '-' to read from stdin.
+
+irods put [options] physical_path [logical_path]
+irods put [options] --files-from manifest [logical_path]
+
+      --connection_pool_size, -c : number of connections used for directory and manifest uploads
+      --files-from               : upload the files listed in a manifest ('-' for stdin), one per line as "source" or "source<TAB>destination";
+                                   relative destinations are resolved against logical_path, and a missing one means logical_path/<file name>
+      --from0                    : manifest records end with a NUL byte instead of a newline
+      --connections              : number of parallel streams per large file or stdin stream (default: derived from link speed)
+      --chunk-size               : size of each unit of work, e.g. 64M (default: derived from file size and link speed)
+      --link-speed               : link speed in Gbit/s used to derive the defaults above (default: 10)
+      --walk-threads             : number of threads scanning local directories (default: 4)
+      --walk-stats               : periodically report the local directory scan rate on stderr
+      --read-mode                : how local files are read: pread or mmap (default: pread)
+      --direct-io                : read local files with O_DIRECT, bypassing the page cache (pread mode only;
+                                   --buffer-size must be a multiple of 4K)
+      --drop-cache               : drop uploaded ranges from the page cache as they are sent
+      --io-depth                 : number of local reads kept in flight per transfer (default: 4)
+      --io-backend               : how local reads are issued: auto, uring, threads or sync (default: auto)
+      --buffer-count             : number of buffers between stdin and the upload (default: 4)
+      --buffer-size              : size of each transfer buffer, used for local reads and for stdin, e.g. 8M (default: 4M)
+      --memory-limit             : upper limit on the memory held in transfer buffers, e.g. 512M; streams wait for buffers once it is reached (default: unlimited)
+      --huge-pages               : back transfer buffers with transparent huge pages
+      --size-hint                : expected size of the stdin stream, e.g. 2T; used to spread it over several connections
+      --sync                     : when uploading a directory, only send files that are missing, differ in size or are newer than their data object;
+                                   with --checksum, files of the same size are compared by SHA-256 checksum instead of time
+      --retries                  : number of times a failed file, chunk or stdin segment is resent, each time on a new connection (default: 3)
+      --resume                   : record the progress of a large file upload and continue an interrupted one; single files only
+      --state-dir                : directory for the progress journals (default: next to the source file)
+      --checksum                 : compute a SHA-256 checksum of the data while it is sent and compare it with the server's checksum
+      --max-bandwidth            : upper limit on the bytes sent per second by all streams together, e.g. 500M (default: unlimited)
+      --max-opens                : upper limit on the data objects opened per second (default: unlimited)
+      --limits-file              : file to re-read the two limits above from while the upload runs, one "max-bandwidth 500M" or "max-opens 100" per line)";
+
+            return help;
         }
 
         auto execute(const std::vector<std::string>& args) -> int override
@@ -94,7 +149,32 @@ namespace irods::cli
             options.add_options()
                 ("physical_path", po::value<std::string>(), "")
                 ("logical_path", po::value<std::string>()->default_value(env.rodsCwd), "")
-                ("connection_pool_size,c", po::value<int>()->default_value(4), "");
+                ("connection_pool_size,c", po::value<int>()->default_value(4), "")
+                ("connections", po::value<int>()->default_value(0), "")
+                ("chunk-size", po::value<std::string>(), "")
+                ("link-speed", po::value<double>()->default_value(10.0), "")
+                ("walk-threads", po::value<int>()->default_value(4), "")
+                ("walk-stats", "")
+                ("read-mode", po::value<std::string>()->default_value("pread"), "")
+                ("direct-io", "")
+                ("drop-cache", "")
+                ("io-depth", po::value<int>()->default_value(4), "")
+                ("io-backend", po::value<std::string>()->default_value("auto"), "")
+                ("buffer-count", po::value<int>()->default_value(4), "")
+                ("buffer-size", po::value<std::string>()->default_value("4M"), "")
+                ("memory-limit", po::value<std::string>()->default_value("0"), "")
+                ("huge-pages", "")
+                ("size-hint", po::value<std::string>(), "")
+                ("sync", "")
+                ("retries", po::value<int>()->default_value(3), "")
+                ("resume", "")
+                ("state-dir", po::value<std::string>()->default_value(""), "")
+                ("checksum", "")
+                ("max-bandwidth", po::value<std::string>()->default_value("0"), "")
+                ("max-opens", po::value<std::uint64_t>()->default_value(0), "")
+                ("limits-file", po::value<std::string>(), "")
+                ("files-from", po::value<std::string>(), "")
+                ("from0", "");
 
             po::positional_options_description positional_options;
             positional_options.add("physical_path", 1);
@@ -114,18 +194,176 @@ namespace irods::cli
                 }
             }
 
-            if (vm.count("physical_path") == 0) {
+            // With a manifest, the only positional argument is the logical path.
+            if (vm.count("files-from") && vm.count("physical_path")) {
+                if (const auto path = canonical(vm["physical_path"].as<std::string>(), env); path) {
+                    logical_path = *path;
+                }
+                else {
+                    std::cerr << "Error: Invalid logical path.\n";
+                    return 1;
+                }
+            }
+            else if (vm.count("physical_path") == 0 && vm.count("files-from") == 0) {
                 std::cerr << "Error: Missing physical path.\n";
                 return 1;
             }
 
+            failures_ = 0;
+
+            put_options opts;
+            opts.pool_size = vm["connection_pool_size"].as<int>();
+            opts.tuning.connections = vm["connections"].as<int>();
+            opts.tuning.link_speed_gbps = vm["link-speed"].as<double>();
+            opts.walk_threads = vm["walk-threads"].as<int>();
+            opts.walk_stats = vm.count("walk-stats") > 0;
+            opts.reading.direct_io = vm.count("direct-io") > 0;
+            opts.reading.drop_cache = vm.count("drop-cache") > 0;
+
+            if (const auto& mode = vm["read-mode"].as<std::string>(); mode == "mmap") {
+                opts.reading.mode = read_mode::mmap;
+            }
+            else if (mode != "pread") {
+                std::cerr << "Error: Invalid read mode [" << mode << "].\n";
+                return 1;
+            }
+
+            opts.io_depth = std::max(vm["io-depth"].as<int>(), 1);
+            opts.retry.retries = std::max(vm["retries"].as<int>(), 0);
+            opts.resume = vm.count("resume") > 0;
+            opts.sync = vm.count("sync") > 0;
+            opts.state_dir = vm["state-dir"].as<std::string>();
+            opts.checksum = vm.count("checksum") > 0;
+
+            if (const auto backend = parse_io_backend(vm["io-backend"].as<std::string>()); backend) {
+                opts.backend = *backend;
+            }
+            else {
+                std::cerr << "Error: Invalid I/O backend [" << vm["io-backend"].as<std::string>() << "].\n";
+                return 1;
+            }
+
+            opts.buffer_count = std::max(vm["buffer-count"].as<int>(), 2);
+
+            if (const auto buffer_size = parse_byte_size(vm["buffer-size"].as<std::string>()); buffer_size && *buffer_size > 0) {
+                opts.buffer_size = *buffer_size;
+            }
+            else {
+                std::cerr << "Error: Invalid buffer size.\n";
+                return 1;
+            }
+
+            // O_DIRECT reads must cover whole logical blocks.
+            if (opts.reading.direct_io && opts.buffer_size % aligned_buffer::alignment != 0) {
+                std::cerr << "Error: The buffer size must be a multiple of " << aligned_buffer::alignment
+                          << " bytes with --direct-io.\n";
+                return 1;
+            }
+
+            if (const auto memory_limit = parse_byte_size(vm["memory-limit"].as<std::string>()); memory_limit) {
+                buffer_pool::instance().configure(*memory_limit, vm.count("huge-pages") > 0);
+            }
+            else {
+                std::cerr << "Error: Invalid memory limit.\n";
+                return 1;
+            }
+
+            if (vm.count("size-hint")) {
+                const auto size_hint = parse_byte_size(vm["size-hint"].as<std::string>());
+
+                if (!size_hint) {
+                    std::cerr << "Error: Invalid size hint.\n";
+                    return 1;
+                }
+
+                opts.size_hint = *size_hint;
+            }
+
+            if (vm.count("chunk-size")) {
+                const auto chunk_size = parse_byte_size(vm["chunk-size"].as<std::string>());
+
+                if (!chunk_size || *chunk_size == 0) {
+                    std::cerr << "Error: Invalid chunk size.\n";
+                    return 1;
+                }
+
+                opts.tuning.chunk_size = *chunk_size;
+            }
+
+            if (const auto rate = parse_byte_size(vm["max-bandwidth"].as<std::string>()); rate) {
+                limits_.bandwidth.set_rate(*rate);
+            }
+            else {
+                std::cerr << "Error: Invalid bandwidth limit.\n";
+                return 1;
+            }
+
+            limits_.opens.set_rate(vm["max-opens"].as<std::uint64_t>());
+
+            std::optional<limits_file_watcher> watcher;
+
+            if (vm.count("limits-file")) {
+                watcher.emplace(vm["limits-file"].as<std::string>(), limits_);
+            }
+
+            // Journals are kept for single files only (see put_from_physical_path).
+            if (opts.resume && (vm.count("files-from") || "-" == vm["physical_path"].as<std::string>())) {
+                std::cerr << "Error: --resume can only be used to upload a single file.\n";
+                return 1;
+            }
+
+            if (vm.count("files-from")) {
+                return put_from_manifest(env, vm["files-from"].as<std::string>(), vm.count("from0") > 0, logical_path, opts);
+            }
+
             return ("-" == vm["physical_path"].as<std::string>())
-                ? put_from_stdin(env, logical_path)
-                : put_from_physical_path(env, vm["physical_path"].as<std::string>(), logical_path, vm["connection_pool_size"].as<int>());
+                ? put_from_stdin(env, logical_path, opts)
+                : put_from_physical_path(env, vm["physical_path"].as<std::string>(), logical_path, opts);
         }
 
     private:
-        auto put_from_stdin(const rodsEnv& _env, const std::string& _logical_path) -> int
+        struct put_options
+        {
+            int pool_size = 4;
+            transfer_tuning tuning;
+            int walk_threads = 4;
+            bool walk_stats = false;
+            read_options reading;
+            int io_depth = 4;
+            io_backend backend = io_backend::automatic;
+            int buffer_count = 4;
+            std::uint64_t buffer_size = 4_MB;
+            std::uint64_t size_hint = 0;
+            retry_policy retry;
+            bool resume = false;
+            std::string state_dir;
+            bool sync = false;
+            bool checksum = false;
+        };
+
+        struct file_task
+        {
+            fs::path from;
+            ifs::path to;
+        };
+
+        // What a helper stream needs to join a replica opened by a leader.
+        struct replica_handle
+        {
+            std::optional<io::replica_token> token;
+            std::optional<io::replica_number> number;
+            std::shared_ptr<digest_sequencer> digest;
+        };
+
+        using scheduler_type = transfer_scheduler<file_task, replica_handle>;
+
+        // Errors reported by the transfer threads of the current command.
+        std::atomic<int> failures_{0};
+
+        // Shared by every stream of the current command.
+        transfer_limits limits_;
+
+        auto put_from_stdin(const rodsEnv& _env, const std::string& _logical_path, const put_options& _options) -> int
         {
             if (_logical_path.empty()) {
                 std::cerr << "Error: The logical path is empty.\n";
@@ -133,23 +371,63 @@ namespace irods::cli
             }
 
             try {
-                irods::connection_pool conn_pool{1, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+                const auto plan = make_stream_plan(_options.size_hint, _options.tuning);
 
-                auto conn = conn_pool.get_connection();
+                // The primary stream of a parallel upload holds a connection of
+                // its own without sending anything.
+                const auto pool_size = plan.parallel ? plan.connections + 1 : plan.connections;
+                irods::connection_pool conn_pool{pool_size, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
 
-                if (ifs::client::exists(conn, _logical_path) && !ifs::client::is_data_object(conn, _logical_path)) {
+                if (auto conn = conn_pool.get_connection();
+                    ifs::client::exists(conn, _logical_path) && !ifs::client::is_data_object(conn, _logical_path))
+                {
                     std::cerr << "Error: The logical path points to something other than a data object.\n";
                     return 1;
                 }
 
+                // A stream that is known (or asked) to be large is spread over
+                // several connections.
+                if (plan.parallel) {
+                    return put_from_stdin_parallel(conn_pool, _logical_path, plan, _options);
+                }
+
+                auto conn = conn_pool.get_connection();
+
                 io::client::default_transport tp{conn};
+                limits_.opens.acquire(1);
 
                 if (io::odstream out{tp, _logical_path}; out) {
-                    std::array<char, 4_MB> buffer{};
+                    // stdin is read on its own thread, so the pipe and the upload
+                    // keep moving at the same time.
+                    buffer_ring ring{static_cast<std::size_t>(_options.buffer_count), _options.buffer_size};
+                    std::optional<sha256_digest> digest;
+
+                    if (_options.checksum) {
+                        digest.emplace();
+                    }
+
+                    pipe_through(
+                        ring,
+                        [](buffer_ring::slot& _slot) {
+                            _slot.size = std::fread(_slot.buffer.data(), 1, _slot.buffer.size(), stdin);
+
+                            if (std::ferror(stdin)) {
+                                throw std::runtime_error{"Cannot read from stdin."};
+                            }
 
-                    while (std::cin && out) {
-                        std::cin.read(&buffer[0], buffer.size());
-                        out.write(&buffer[0], std::cin.gcount());
+                            return _slot.size == _slot.buffer.size();
+                        },
+                        [&](const buffer_ring::slot& _slot) {
+                            send(out, _logical_path, _slot.buffer.data(), _slot.size);
+
+                            if (digest) {
+                                digest->update(_slot.buffer.data(), _slot.size);
+                            }
+                        });
+
+                    if (digest) {
+                        out.close();
+                        verify_upload(conn, _logical_path, digest->finish());
                     }
                 }
                 else {
@@ -165,19 +443,204 @@ namespace irods::cli
             return 0;
         }
 
-        auto put_from_physical_path(const rodsEnv& _env, const std::string& _from, const ifs::path& to, const int pool_size) -> int
+        // Uploads stdin over several connections. stdin is cut into segments;
+        // each connection takes the next filled segment and writes it at its
+        // offset, so a slow connection never holds up the others. The reader
+        // waits for a free segment once they are all in use.
+        //
+        // Segments are at most the planned chunk size. There are two per
+        // connection, or --buffer-count if that is more, and together they stay
+        // within the memory limit (or max_stdin_ring_size without one).
+        //
+        // As with chunked file uploads, the primary stream creates the replica
+        // and the other streams join it through its replica token. The primary
+        // stream sends nothing itself: a joined stream can move to a new
+        // connection, so a segment that fails is retried on a fresh stream, up
+        // to the retry budget. The data object is finalized once stdin reaches
+        // EOF and every stream has closed.
+        //
+        // A checksum is computed over the segments in stdin order. Segments that
+        // are sent ahead of an earlier one are held until it arrives; the stream
+        // with the earliest segment never waits for them.
+        auto put_from_stdin_parallel(irods::connection_pool& _cpool,
+                                     const std::string& _logical_path,
+                                     const transfer_plan& _plan,
+                                     const put_options& _options) -> int
+        {
+            constexpr std::uint64_t max_stdin_ring_size = 1 * gibibyte;
+
+            const auto segment_count =
+                std::max(2 * static_cast<std::size_t>(_plan.connections), static_cast<std::size_t>(_options.buffer_count));
+            const auto memory_limit = buffer_pool::instance().memory_limit();
+            auto segment_size =
+                std::min<std::uint64_t>(_plan.chunk_size, (memory_limit > 0 ? memory_limit : max_stdin_ring_size) / segment_count);
+            segment_size = std::max<std::uint64_t>(segment_size - segment_size % aligned_buffer::alignment,
+                                                   aligned_buffer::alignment);
+
+            buffer_ring ring{segment_count, static_cast<std::size_t>(segment_size)};
+            std::atomic<bool> failed{false};
+            std::optional<digest_sequencer> digest;
+
+            if (_options.checksum) {
+                digest.emplace(segment_count * segment_size);
+            }
+
+            const auto fail = [&](const std::exception& _e) {
+                std::cerr << "Error: " << _e.what() << '\n';
+                failed = true;
+                ring.cancel();
+
+                if (digest) {
+                    digest->abandon();
+                }
+            };
+
+            auto conn = _cpool.get_connection();
+            io::client::default_transport tp{conn};
+            limits_.opens.acquire(1);
+            io::odstream primary{tp, _logical_path};
+
+            if (!primary) {
+                std::cerr << "Error: Could not open output stream [path => " << _logical_path << "].\n";
+                return 1;
+            }
+
+            const auto& token = primary.replica_token();
+            const auto& replica_number = primary.replica_number();
+            const ifs::path to{_logical_path};
+
+            irods::thread_pool tpool{_plan.connections};
+
+            for (int i = 0; i < _plan.connections; ++i) {
+                irods::thread_pool::post(tpool, [&] {
+                    try {
+                        joined_stream out{_cpool, token, replica_number, to};
+
+                        while (auto* s = ring.acquire_filled()) {
+                            for (int attempt = 0;; ++attempt) {
+                                try {
+                                    auto& o = out.get(attempt > 0);
+
+                                    if (!o.seekp(static_cast<std::streamoff>(s->offset))) {
+                                        throw std::runtime_error{"Seek failed [path: " + _logical_path + "]."};
+                                    }
+
+                                    send(o, to, s->buffer.data(), s->size);
+
+                                    if (digest) {
+                                        digest->feed(s->offset, s->buffer.data(), s->size);
+                                    }
+
+                                    break;
+                                }
+                                catch (const std::exception& e) {
+                                    if (attempt >= _options.retry.retries) {
+                                        ring.push_empty(s);
+                                        throw;
+                                    }
+
+                                    std::cerr << "Warning: " << e.what() << " Retrying the segment at offset "
+                                              << s->offset << " [path: " << _logical_path << "].\n";
+                                    std::this_thread::sleep_for(_options.retry.delay(attempt));
+                                }
+                            }
+
+                            ring.push_empty(s);
+                        }
+
+                        out.close();
+                    }
+                    catch (const std::exception& e) {
+                        fail(e);
+                    }
+                });
+            }
+
+            std::uint64_t offset = 0;
+
+            try {
+                for (;;) {
+                    auto* s = ring.acquire_empty();
+
+                    if (!s) {
+                        break;
+                    }
+
+                    s->offset = offset;
+                    s->size = std::fread(s->buffer.data(), 1, s->buffer.size(), stdin);
+                    offset += s->size;
+
+                    if (std::ferror(stdin)) {
+                        ring.push_empty(s);
+                        throw std::runtime_error{"Cannot read from stdin."};
+                    }
+
+                    const auto at_end = s->size < s->buffer.size();
+
+                    if (s->size > 0) {
+                        ring.push_filled(s);
+                    }
+                    else {
+                        ring.push_empty(s);
+                    }
+
+                    if (at_end) {
+                        break;
+                    }
+                }
+            }
+            catch (const std::exception& e) {
+                fail(e);
+            }
+
+            ring.close();
+
+            // The secondary streams must be closed before the primary stream.
+            tpool.join();
+            close_primary(primary, !failed);
+
+            if (failed) {
+                return 1;
+            }
+
+            if (digest) {
+                try {
+                    if (const auto d = digest->finish(offset); d) {
+                        verify_upload(conn, _logical_path, *d);
+                    }
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Error: " << e.what() << '\n';
+                    return 1;
+                }
+            }
+
+            return 0;
+        }
+
+        auto put_from_physical_path(const rodsEnv& _env,
+                                    const std::string& _from,
+                                    const ifs::path& to,
+                                    const put_options& _options) -> int
         {
             const auto from = fs::canonical(_from);
             try {
 
                 if (fs::is_regular_file(from)) {
-                    put_file(_env, from, to / from.filename().string());
+                    put_file(_env, from, to / from.filename().string(), _options);
                 }
                 else if (fs::is_directory(from)) {
-                    irods::connection_pool conn_pool{pool_size, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
-                    irods::thread_pool thread_pool{static_cast<int>(std::thread::hardware_concurrency())};
-                    put_directory(conn_pool, thread_pool, from, to / std::rbegin(from)->string());
-                    thread_pool.join();
+                    if (_options.resume) {
+                        std::cerr << "Error: --resume can only be used to upload a single file.\n";
+                        return 1;
+                    }
+
+                    // One spare connection for a worker whose primary stream handed
+                    // units back (see lead_large_file).
+                    irods::connection_pool conn_pool{_options.pool_size + 1, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+                    // One connection per walker thread, for creating and listing collections.
+                    irods::connection_pool walk_pool{std::max(_options.walk_threads, 1), _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+                    put_directory(conn_pool, walk_pool, from, to / std::rbegin(from)->string(), _options);
                 }
                 else {
                     std::cerr << "Error: Path must point to a file or directory.\n";
@@ -189,177 +652,1277 @@ namespace irods::cli
                 return 1;
             }
 
-            return 0;
+            return failures_ > 0 ? 1 : 0;
         }
 
-        auto put_file_chunk(irods::connection_pool& _cpool,
-                            const fs::path& _from,
-                            const ifs::path& _to,
-                            unsigned long _offset,
-                            unsigned long _chunk_size) -> void
+        // Reports an error that does not stop the rest of the job, but must
+        // still be reflected in the exit status.
+        auto report_error(const std::exception& _e) -> void
         {
-            try {
-                std::ifstream in{_from.c_str(), std::ios_base::binary};
+            ++failures_;
+            std::cerr << "Error: " << _e.what() << '\n';
+        }
 
-                if (!in) {
-                    throw std::runtime_error{"Cannot open file for reading."};
+        // Compares the digest computed while sending with the checksum of the new
+        // replica. A mismatch is thrown as an error.
+        static auto verify_upload(rcComm_t& _comm, const ifs::path& _to, const std::string& _digest) -> void
+        {
+            if (!verify_checksum(_comm, _to.string(), _digest)) {
+                std::cerr << "Warning: The data object has no SHA-256 checksum and the zone does not use SHA-256; "
+                             "the upload cannot be verified [path: "
+                          << _to.string() << "].\n";
+            }
+        }
+
+        // Bytes a chunked upload may hold back for its checksum while an earlier
+        // chunk is still on its way.
+        static auto reorder_limit(std::uint64_t _chunk_size, int _streams) -> std::size_t
+        {
+            return static_cast<std::size_t>(std::min<std::uint64_t>(_chunk_size * std::max(_streams, 1), 256_MB));
+        }
+
+        // Reader used for local files. Its buffers come from the process-wide
+        // pool and go back when it is destroyed, so a reader is only kept for as
+        // long as one transfer needs it. With a memory limit this waits for
+        // buffers, which is why it must happen before any chunk is claimed; a
+        // claimed chunk may be what other streams are waiting for.
+        static auto make_reader(const put_options& _options) -> async_reader
+        {
+            return async_reader{static_cast<std::size_t>(_options.buffer_size), _options.io_depth, _options.backend};
+        }
+
+        // dstreams do not buffer, so handing the bytes to the stream buffer sends
+        // them straight to the transport without going through ostream.
+        auto send(io::odstream& _out, const ifs::path& _to, const char* _data, std::size_t _size) -> void
+        {
+            limits_.bandwidth.acquire(_size);
+
+            if (_out.rdbuf()->sputn(_data, static_cast<std::streamsize>(_size)) != static_cast<std::streamsize>(_size)) {
+                throw std::runtime_error{"Write failed [path: " + _to.string() + "]."};
+            }
+        }
+
+        // Sends one unit of a local file through _out at its offset. The bytes
+        // sent are also fed to _digest, if any.
+        auto send_chunk(local_file& _in,
+                        async_reader& _reader,
+                        io::odstream& _out,
+                        const chunk& _chunk,
+                        const ifs::path& _to,
+                        digest_sequencer* _digest) -> void
+        {
+            if (!_out.seekp(_chunk.offset)) {
+                throw std::runtime_error{"Seek failed [path: " + _to.string() + "]."};
+            }
+
+            auto pos = _chunk.offset;
+
+            _in.read_range(_chunk.offset, _chunk.size, _reader, [&](const char* _data, std::size_t _size) {
+                send(_out, _to, _data, _size);
+
+                if (_digest) {
+                    _digest->feed(pos, _data, _size);
                 }
 
-                auto conn = _cpool.get_connection();
-                io::client::default_transport tp{conn};
-                io::odstream out{tp, _to};
+                pos += _size;
+            });
+        }
 
-                if (!out) {
-                    throw std::runtime_error{"Cannot open data object for writing [path: " + _to.string() + "]."};
+        // Claims units from the shared scheduler and writes them through the
+        // stream returned by _stream(bool) until none remain. Fast streams
+        // naturally take more units than slow ones.
+        //
+        // A unit that fails is sent again after a backoff, up to the retry
+        // budget. For the retry, _stream(true) is asked for a fresh stream, which
+        // lets helper streams move to a new connection. Once the budget is used
+        // up the error is thrown and the unit is left out of the journal.
+        //
+        // The bytes sent are also fed to _digest, if any, at their offsets. A
+        // retried unit feeds the same bytes again, which the sequencer ignores; a
+        // unit that is given up on abandons the checksum.
+        template <typename Stream>
+        auto write_chunks(chunk_scheduler& _scheduler,
+                          const fs::path& _from,
+                          Stream&& _stream,
+                          const ifs::path& _to,
+                          const put_options& _options,
+                          transfer_journal* _journal = nullptr,
+                          digest_sequencer* _digest = nullptr) -> void
+        {
+            local_file in{_from.string(), _options.reading};
+            auto local_reader = make_reader(_options);
+
+            while (const auto chunk = _scheduler.next()) {
+                for (int attempt = 0;; ++attempt) {
+                    try {
+                        send_chunk(in, local_reader, _stream(attempt > 0), *chunk, _to, _digest);
+                        break;
+                    }
+                    catch (const std::exception& e) {
+                        if (attempt >= _options.retry.retries) {
+                            if (_digest) {
+                                _digest->abandon();
+                            }
+
+                            throw;
+                        }
+
+                        std::cerr << "Warning: " << e.what() << " Retrying chunk " << chunk->index << " [path: "
+                                  << _to.string() << "].\n";
+                        std::this_thread::sleep_for(_options.retry.delay(attempt));
+                    }
+                }
+
+                _scheduler.mark_done(*chunk);
+
+                if (_journal) {
+                    _journal->mark_done(chunk->index);
                 }
+            }
+        }
+
+        // Writes units through the primary stream, which cannot move to another
+        // connection without losing the replica. The first unit that fails is
+        // handed back to the scheduler for a joined stream, which can reconnect,
+        // and the primary stream sends nothing more. Returns false in that case.
+        //
+        // Handing a unit back abandons the streaming checksum: the streams that
+        // are ahead of it could otherwise wait on the digest for a unit that no
+        // stream is free to take. The caller computes the checksum from the
+        // local file instead.
+        auto lead_chunks(chunk_scheduler& _scheduler,
+                         const fs::path& _from,
+                         io::odstream& _primary,
+                         const ifs::path& _to,
+                         const put_options& _options,
+                         transfer_journal* _journal,
+                         digest_sequencer* _digest) -> bool
+        {
+            local_file in{_from.string(), _options.reading};
+            auto local_reader = make_reader(_options);
 
-                if (!in.seekg(_offset)) {
-                    throw std::runtime_error{"Seek failed [path: " + _from.generic_string() + "]."};
+            while (const auto chunk = _scheduler.next()) {
+                try {
+                    send_chunk(in, local_reader, _primary, *chunk, _to, _digest);
                 }
+                catch (const std::exception& e) {
+                    std::cerr << "Warning: " << e.what() << " Handing chunk " << chunk->index
+                              << " to another stream [path: " << _to.string() << "].\n";
 
-                if (!out.seekp(_offset)) {
-                    throw std::runtime_error{"Seek failed [path: " + _to.string() + "]."};
+                    if (_digest) {
+                        _digest->abandon();
+                    }
+
+                    _scheduler.requeue(*chunk);
+
+                    return false;
                 }
 
-                std::array<char, 4_MB> buf{};
-                unsigned long bytes_pushed = 0;
+                _scheduler.mark_done(*chunk);
 
-                while (in && bytes_pushed < _chunk_size) {
-                    in.read(buf.data(), std::min(buf.size(), _chunk_size));
-                    out.write(buf.data(), in.gcount());
-                    bytes_pushed += in.gcount();
+                if (_journal) {
+                    _journal->mark_done(chunk->index);
                 }
             }
-            catch (const std::exception& e) {
-                std::cerr << "Error: " << e.what() << '\n';
+
+            return true;
+        }
+
+        // Closes the primary stream. A replica that is missing units keeps the
+        // status it was opened with instead of being marked good, and is left
+        // for --resume or a later upload to complete.
+        static auto close_primary(io::odstream& _primary, bool _complete) -> void
+        {
+            if (_complete) {
+                _primary.close();
+                return;
             }
+
+            io::on_close_success close_input;
+            close_input.update_status = false;
+            close_input.compute_checksum = false;
+            close_input.send_notifications = false;
+
+            _primary.close(&close_input);
         }
 
-        auto put_file(const rodsEnv& _env, const fs::path& _from, const ifs::path& _to) -> void
+        // Closes a stream whose upload failed partway, leaving its replica stale.
+        // The error that got it here is the one worth reporting, so a failure to
+        // close is ignored.
+        static auto close_incomplete(io::odstream& _out) -> void
         {
+            if (!_out.is_open()) {
+                return;
+            }
+
             try {
-                const auto file_size = fs::file_size(_from);
+                close_primary(_out, false);
+            }
+            catch (const std::exception&) {
+            }
+        }
 
-                // If the local file's size is less than 32MB, then stream the file
-                // over a single connection.
-                if (file_size < 32_MB) {
-                    irods::connection_pool cpool{1, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+        // A stream that joins the replica opened by the primary stream, over a
+        // connection of its own. It is opened on first use. Secondary streams
+        // never touch the catalog on close; the primary stream finalizes the
+        // replica once all of them are done.
+        //
+        // get(true) asks for a fresh stream after a failure. The old stream is
+        // closed and its connection is taken out of the pool and disconnected,
+        // since it may be broken; the pool opens a new connection in its place,
+        // on which the replica is joined again.
+        class joined_stream
+        {
+        public:
+            joined_stream(irods::connection_pool& _cpool,
+                          const io::replica_token& _token,
+                          const io::replica_number& _replica_number,
+                          const ifs::path& _to)
+                : cpool_{_cpool}
+                , token_{_token}
+                , replica_number_{_replica_number}
+                , to_{_to}
+            {
+            }
 
-                    // If the local file is empty, just create an empty data object
-                    // on the iRODS server and return.
-                    if (file_size == 0) {
-                        auto conn = cpool.get_connection();
-                        io::client::default_transport tp{conn};
-                        io::odstream out{tp, _to};
+            joined_stream(const joined_stream&) = delete;
+            auto operator=(const joined_stream&) -> joined_stream& = delete;
 
-                        if (!out) {
-                            throw std::runtime_error{"Cannot open data object for writing [path: " + _to.string() + "]."};
-                        }
+            ~joined_stream()
+            {
+                try {
+                    close();
+                }
+                catch (...) {
+                }
+            }
 
-                        return;
+            auto get(bool _reconnect) -> io::odstream&
+            {
+                if (out_ && !_reconnect) {
+                    return *out_;
+                }
+
+                if (conn_) {
+                    try {
+                        close();
+                    }
+                    catch (const std::exception&) {
+                        out_.reset();
+                        tp_.reset();
                     }
 
-                    put_file(cpool.get_connection(), _from, _to);
+                    if (auto* comm = conn_->release(); comm) {
+                        rcDisconnect(comm);
+                    }
 
-                    return;
+                    conn_.reset();
                 }
 
-                using int_type = unsigned long;
+                conn_.emplace(cpool_.get_connection());
+                tp_.emplace(*conn_);
+                out_.emplace(*tp_, token_, to_, replica_number_, std::ios_base::in | std::ios_base::out);
 
-                constexpr int_type thread_count = 3;
-                irods::connection_pool cpool{thread_count, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
-                irods::thread_pool tpool{static_cast<int>(thread_count)};
+                if (!*out_) {
+                    throw std::runtime_error{"Cannot open data object for writing [path: " + to_.string() + "]."};
+                }
 
-                const int_type chunk_size = file_size / thread_count;
-                const int_type remainder = file_size % thread_count;
+                return *out_;
+            }
 
-                {
-                    auto conn = cpool.get_connection();
-                    io::client::default_transport tp{conn};
-                    io::odstream{tp, _to};
+            auto close() -> void
+            {
+                if (!out_) {
+                    return;
                 }
 
-                for (int_type i = 0; i < thread_count; ++i) {
-                    irods::thread_pool::post(tpool, [&, offset = i * chunk_size] {
-                        put_file_chunk(cpool, _from, _to, offset, chunk_size);
-                    });
-                }
+                io::on_close_success close_input;
+                close_input.update_size = false;
+                close_input.update_status = false;
+                close_input.compute_checksum = false;
+                close_input.send_notifications = false;
 
-                if (remainder > 0) {
-                    irods::thread_pool::post(tpool, [&, offset = thread_count * chunk_size] {
-                        put_file_chunk(cpool, _from, _to, offset, remainder);
-                    });
-                }
+                // Must happen explicitly; the destructor would finalize the replica.
+                out_->close(&close_input);
+                out_.reset();
+                tp_.reset();
+            }
 
-                tpool.join();
+        private:
+            irods::connection_pool& cpool_;
+            const io::replica_token& token_;
+            const io::replica_number& replica_number_;
+            const ifs::path& to_;
+
+            std::optional<irods::connection_pool::connection_proxy> conn_;
+            std::optional<io::client::default_transport> tp_;
+            std::optional<io::odstream> out_;
+        }; // class joined_stream
+
+        // Joins the replica opened by the primary stream and writes units until
+        // none remain.
+        auto put_file_chunks(irods::connection_pool& _cpool,
+                             chunk_scheduler& _scheduler,
+                             const io::replica_token& _token,
+                             const io::replica_number& _replica_number,
+                             const fs::path& _from,
+                             const ifs::path& _to,
+                             const put_options& _options,
+                             transfer_journal* _journal = nullptr,
+                             digest_sequencer* _digest = nullptr) -> void
+        {
+            joined_stream out{_cpool, _token, _replica_number, _to};
+
+            try {
+                write_chunks(
+                    _scheduler,
+                    _from,
+                    [&out](bool _reconnect) -> io::odstream& { return out.get(_reconnect); },
+                    _to,
+                    _options,
+                    _journal,
+                    _digest);
+                out.close();
             }
             catch (const std::exception& e) {
-                std::cerr << "Error: " << e.what() << '\n';
+                report_error(e);
             }
         }
 
-        auto put_file(rcComm_t& _comm, const fs::path& _from, const ifs::path& _to) -> void
+        auto put_file(const rodsEnv& _env, const fs::path& _from, const ifs::path& _to, const put_options& _options)
+            -> void
         {
             try {
                 const auto file_size = fs::file_size(_from);
+                const auto plan = make_transfer_plan(file_size, _options.tuning);
 
-                // If the local file is empty, just create an empty data object
-                // on the iRODS server and return.
-                if (file_size == 0) {
-                    io::client::default_transport tp{_comm};
-                    io::odstream out{tp, _to};
+                // Files that are too small to split are streamed over a single connection.
+                if (!plan.parallel) {
+                    irods::connection_pool cpool{1, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+                    put_file(cpool, _from, _to, file_size, _options);
 
-                    if (!out) {
-                        throw std::runtime_error{"Cannot open data object for writing [path: " + _to.string() + "]."};
+                    return;
+                }
+
+                // One connection more than there are streams, for a joined stream
+                // that takes over units the primary stream handed back.
+                irods::connection_pool cpool{plan.connections + 1, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+                irods::thread_pool tpool{plan.connections};
+                auto conn = cpool.get_connection();
+
+                std::unique_ptr<transfer_journal> journal;
+                bool resuming = false;
+
+                if (_options.resume) {
+                    const auto path = transfer_journal::path_for(_from.string(), _to.string(), _options.state_dir);
+                    journal = std::make_unique<transfer_journal>(path, _from.string(), _to.string(), plan.chunk_size);
+
+                    if (journal->resumed()) {
+                        resuming = verify_resumable(conn, _from, _to, *journal);
+
+                        if (!resuming) {
+                            std::cerr << "Warning: The data object does not match the journal and will be uploaded again "
+                                         "[path: " << _to.string() << "].\n";
+                            journal->restart();
+                        }
                     }
+                }
 
-                    return;
+                chunk_scheduler scheduler{file_size, journal ? journal->chunk_size() : plan.chunk_size};
+
+                if (resuming) {
+                    scheduler.skip(journal->completed());
                 }
 
-                std::ifstream in{_from.c_str(), std::ios_base::binary};
+                // A resumed upload does not send the chunks it already has, so its
+                // checksum is computed from the local file once it is complete.
+                std::unique_ptr<digest_sequencer> digest;
 
-                if (!in) {
-                    throw std::runtime_error{"Cannot open file for reading [path: " + _from.generic_string() + "]."};
+                if (_options.checksum && !resuming) {
+                    digest = std::make_unique<digest_sequencer>(reorder_limit(scheduler.chunk_size(), plan.connections));
                 }
 
-                io::client::default_transport tp{_comm};
-                io::odstream out{tp, _to};
+                // The primary stream is the only one that goes through a full open and
+                // close in the catalog. Every other stream joins its replica via the
+                // replica token, so the replica is created and finalized exactly once.
+                // A resumed upload must not truncate the bytes it is building on.
+                io::client::default_transport tp{conn};
+                limits_.opens.acquire(1);
+                io::odstream primary{tp, _to, resuming ? std::ios_base::in | std::ios_base::out : std::ios_base::out};
 
-                if (!out) {
+                if (!primary) {
                     throw std::runtime_error{"Cannot open data object for writing [path: " + _to.string() + "]."};
                 }
 
-                std::array<char, 4_MB> buf{};
+                const auto& token = primary.replica_token();
+                const auto& replica_number = primary.replica_number();
 
-                while (in) {
-                    in.read(buf.data(), buf.size());
-                    out.write(buf.data(), in.gcount());
+                for (int i = 1; i < plan.connections; ++i) {
+                    irods::thread_pool::post(tpool, [&] {
+                        put_file_chunks(cpool, scheduler, token, replica_number, _from, _to, _options, journal.get(), digest.get());
+                    });
                 }
-            }
-            catch (const std::exception& e) {
-                std::cerr << "Error: " << e.what() << '\n';
-            }
-        }
 
-        auto put_directory(irods::connection_pool& _conn_pool,
-                           irods::thread_pool& _thread_pool,
-                           const fs::path& _from,
-                           const ifs::path& _to) -> void
-        {
-            ifs::client::create_collections(_conn_pool.get_connection(), _to);
+                bool primary_done = false;
 
-            for (auto&& e : fs::directory_iterator{_from}) {
-                irods::thread_pool::post(_thread_pool, [this, &_conn_pool, &_thread_pool, e, _to]() {
-                    const auto& from = e.path();
+                try {
+                    primary_done = lead_chunks(scheduler, _from, primary, _to, _options, journal.get(), digest.get());
+                }
+                catch (const std::exception& e) {
+                    report_error(e);
+                }
 
-                    if (fs::is_regular_file(e.status())) {
-                        put_file(_conn_pool.get_connection(), from, _to / from.filename().string());
-                    }
-                    else if (fs::is_directory(e.status())) {
-                        put_directory(_conn_pool, _thread_pool, from, _to / std::rbegin(from)->string());
-                    }
-                });
-            }
+                // The secondary streams must be closed before the primary stream.
+                tpool.join();
+
+                // Units the primary stream handed back after every helper had finished.
+                if (!scheduler.exhausted()) {
+                    put_file_chunks(cpool, scheduler, token, replica_number, _from, _to, _options, journal.get(), digest.get());
+                }
+
+                const auto complete = scheduler.all_done();
+                close_primary(primary, complete);
+
+                // An incomplete upload keeps its journal for the next --resume.
+                if (!complete) {
+                    throw std::runtime_error{"Not every chunk was uploaded; the replica was not marked good [path: " +
+                                             _to.string() + "]."};
+                }
+
+                if (journal) {
+                    journal->remove();
+                }
+
+                if (_options.checksum) {
+                    if (resuming || !primary_done) {
+                        verify_upload(conn, _to, digest_of(_from, _options));
+                    }
+                    else if (const auto d = digest->finish(file_size); d) {
+                        verify_upload(conn, _to, *d);
+                    }
+                }
+            }
+            catch (const std::exception& e) {
+                report_error(e);
+            }
+        }
+
+        // Decides whether the data object left behind by an interrupted upload
+        // can be built on. Its size must cover every chunk the journal records
+        // and must not exceed the local file. A bounded sample of the recorded
+        // chunks is then read back and compared with the local file: the first
+        // and last ones and others spread evenly between, the tail of each. That
+        // catches an object that was replaced or modified since the journal was
+        // written, and the last chunk, the likeliest not to have landed, is
+        // always checked; resuming costs a few reads however much was sent.
+        auto verify_resumable(rcComm_t& _comm,
+                              const fs::path& _from,
+                              const ifs::path& _to,
+                              const transfer_journal& _journal) -> bool
+        {
+            constexpr std::size_t max_samples = 8;
+            constexpr std::uint64_t sample_size = mebibyte;
+
+            if (!ifs::client::exists(_comm, _to) || !ifs::client::is_data_object(_comm, _to)) {
+                return false;
+            }
+
+            const auto file_size = fs::file_size(_from);
+            const auto chunk_size = _journal.chunk_size();
+            const auto& completed = _journal.completed();
+
+            std::vector<std::uint64_t> done;
+            std::uint64_t covered = 0;
+
+            for (std::uint64_t i = 0; i < completed.size(); ++i) {
+                if (completed[i]) {
+                    done.push_back(i);
+                    covered = std::min((i + 1) * chunk_size, file_size);
+                }
+            }
+
+            if (const auto remote_size = ifs::client::data_object_size(_comm, _to);
+                remote_size < covered || remote_size > file_size)
+            {
+                return false;
+            }
+
+            std::vector<std::uint64_t> samples;
+
+            if (done.size() <= max_samples) {
+                samples = done;
+            }
+            else {
+                for (std::size_t k = 0; k < max_samples; ++k) {
+                    samples.push_back(done[k * (done.size() - 1) / (max_samples - 1)]);
+                }
+            }
+
+            io::client::default_transport tp{_comm};
+            io::idstream remote{tp, _to};
+            std::ifstream local{_from.string(), std::ios::binary};
+
+            if (!remote || !local) {
+                return false;
+            }
+
+            std::vector<char> remote_bytes(sample_size);
+            std::vector<char> local_bytes(sample_size);
+
+            for (const auto i : samples) {
+                const auto end = std::min((i + 1) * chunk_size, file_size);
+                const auto offset = std::max(i * chunk_size, end - std::min(end, sample_size));
+                const auto n = static_cast<std::streamsize>(end - offset);
+
+                remote.seekg(static_cast<std::streamoff>(offset));
+                local.seekg(static_cast<std::streamoff>(offset));
+
+                remote.read(remote_bytes.data(), n);
+                local.read(local_bytes.data(), n);
+
+                if (remote.gcount() != n || local.gcount() != n ||
+                    !std::equal(remote_bytes.data(), remote_bytes.data() + n, local_bytes.data()))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // Reads a local file from start to end to compute its checksum. Only
+        // needed when the bytes were not all sent in this run.
+        auto digest_of(const fs::path& _from, const put_options& _options) -> std::string
+        {
+            local_file in{_from.string(), _options.reading};
+            sha256_digest digest;
+
+            auto local_reader = make_reader(_options);
+
+            in.read_range(0, in.size(), local_reader, [&digest](const char* _data, std::size_t _size) {
+                digest.update(_data, _size);
+            });
+
+            return digest.finish();
+        }
+
+        // Uploads a file over one connection of the pool. A failed upload is
+        // started over, each time on a new connection, until the retries are
+        // used up. _attempt is the number of attempts made already.
+        auto put_file(irods::connection_pool& _cpool,
+                      const fs::path& _from,
+                      const ifs::path& _to,
+                      std::uint64_t _file_size,
+                      const put_options& _options,
+                      int _attempt = 0) -> void
+        {
+            for (int attempt = _attempt;; ++attempt) {
+                if (attempt > 0) {
+                    std::this_thread::sleep_for(_options.retry.delay(attempt - 1));
+                }
+
+                try {
+                    auto conn = _cpool.get_connection();
+
+                    try {
+                        send_file(conn, _from, _to, _file_size, _options);
+                        return;
+                    }
+                    catch (const std::exception&) {
+                        // The connection may be unusable; the pool opens a new one in its place.
+                        if (auto* comm = conn.release(); comm) {
+                            rcDisconnect(comm);
+                        }
+
+                        throw;
+                    }
+                }
+                catch (const std::exception& e) {
+                    if (attempt >= _options.retry.retries) {
+                        report_error(e);
+                        return;
+                    }
+
+                    std::cerr << "Warning: " << e.what() << " Retrying the upload [path: " << _to.string() << "].\n";
+                }
+            }
+        }
+
+        // Sends a file over a single stream. An upload that fails partway
+        // leaves the replica without marking it good, so that it is never
+        // taken for a complete copy.
+        auto send_file(rcComm_t& _comm,
+                       const fs::path& _from,
+                       const ifs::path& _to,
+                       std::uint64_t _file_size,
+                       const put_options& _options) -> void
+        {
+            // If the local file is empty, just create an empty data object
+            // on the iRODS server and return.
+            limits_.opens.acquire(1);
+
+            if (_file_size == 0) {
+                {
+                    io::client::default_transport tp{_comm};
+                    io::odstream out{tp, _to};
+
+                    if (!out) {
+                        throw std::runtime_error{"Cannot open data object for writing [path: " + _to.string() + "]."};
+                    }
+                }
+
+                if (_options.checksum) {
+                    verify_upload(_comm, _to, sha256_digest{}.finish());
+                }
+
+                return;
+            }
+
+            local_file in{_from.string(), _options.reading};
+
+            io::client::default_transport tp{_comm};
+            io::odstream out{tp, _to};
+
+            if (!out) {
+                throw std::runtime_error{"Cannot open data object for writing [path: " + _to.string() + "]."};
+            }
+
+            std::optional<sha256_digest> digest;
+
+            if (_options.checksum) {
+                digest.emplace();
+            }
+
+            auto local_reader = make_reader(_options);
+
+            try {
+                in.read_range(0, in.size(), local_reader, [&](const char* _data, std::size_t _size) {
+                    send(out, _to, _data, _size);
+
+                    if (digest) {
+                        digest->update(_data, _size);
+                    }
+                });
+            }
+            catch (const std::exception&) {
+                close_incomplete(out);
+                throw;
+            }
+
+            if (digest) {
+                out.close();
+                verify_upload(_comm, _to, digest->finish());
+            }
+        }
+
+        // Uploads a directory tree. Every file goes through one scheduler that
+        // shares the connection pool: large files are split into chunks and
+        // uploaded over several connections, biggest first, while the remaining
+        // workers keep the small files moving.
+        //
+        // The walk runs concurrently with the uploads and blocks whenever the
+        // scheduler's queues are full, so memory does not grow with the tree. It
+        // talks to the server over _walk_pool, so it never holds a connection a
+        // worker is waiting for.
+        auto put_directory(irods::connection_pool& _conn_pool,
+                           irods::connection_pool& _walk_pool,
+                           const fs::path& _from,
+                           const ifs::path& _to,
+                           const put_options& _options) -> void
+        {
+            transfer_all(_conn_pool, _options, [&](scheduler_type& _scheduler) {
+                walk_directory(_walk_pool, _scheduler, _from, _to, _options);
+            });
+        }
+
+        // Uploads the files listed in a manifest, the same way as a directory
+        // tree: the manifest is read on its own thread and fed to the scheduler,
+        // which bounds how far reading runs ahead of the uploads.
+        auto put_from_manifest(const rodsEnv& _env,
+                               const std::string& _manifest,
+                               bool _null_delimited,
+                               const ifs::path& _to,
+                               const put_options& _options) -> int
+        {
+            std::FILE* in = stdin;
+
+            if (_manifest != "-") {
+                in = std::fopen(_manifest.c_str(), "r");
+
+                if (!in) {
+                    std::cerr << "Error: Cannot open manifest [path: " << _manifest << ", error: " << std::strerror(errno)
+                              << "].\n";
+                    return 1;
+                }
+            }
+
+            try {
+                manifest_reader manifest{in, _null_delimited ? '\0' : '\n'};
+                // One spare connection for a worker whose primary stream handed
+                // units back (see lead_large_file).
+                irods::connection_pool conn_pool{_options.pool_size + 1, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+                // The reader creates collections over a connection of its own.
+                irods::connection_pool feed_pool{1, _env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, 600};
+
+                transfer_all(conn_pool, _options, [&](scheduler_type& _scheduler) {
+                    feed_manifest(feed_pool, _scheduler, manifest, _to);
+                });
+            }
+            catch (const std::exception& e) {
+                report_error(e);
+            }
+
+            if (in != stdin) {
+                std::fclose(in);
+            }
+
+            return failures_ > 0 ? 1 : 0;
+        }
+
+        // Runs the transfer workers, one connection of _conn_pool each, while
+        // _feed(scheduler_type&) adds files to the scheduler on a thread of its
+        // own. The feed brings its own connections.
+        template <typename Feed>
+        auto transfer_all(irods::connection_pool& _conn_pool, const put_options& _options, Feed&& _feed) -> void
+        {
+            const auto workers = _options.pool_size;
+            scheduler_type scheduler{workers};
+            irods::thread_pool thread_pool{workers + 1};
+
+            irods::thread_pool::post(thread_pool, [&] {
+                try {
+                    _feed(scheduler);
+                }
+                catch (const std::exception& e) {
+                    report_error(e);
+                }
+
+                scheduler.close();
+            });
+
+            for (int i = 0; i < workers; ++i) {
+                irods::thread_pool::post(thread_pool, [&] {
+                    transfer_worker(_conn_pool, scheduler, _options);
+                });
+            }
+
+            thread_pool.join();
+        }
+
+        // Queues every file of a manifest. The parent collection of each target is
+        // created first unless it is already known to exist; since manifests from
+        // indexers tend to list the files of a directory together, the cache
+        // answers nearly every lookup without asking the server.
+        auto feed_manifest(irods::connection_pool& _conn_pool,
+                           scheduler_type& _scheduler,
+                           manifest_reader& _manifest,
+                           const ifs::path& _to) -> void
+        {
+            collection_cache collections;
+
+            while (auto entry = _manifest.next()) {
+                try {
+                    if (entry->source.empty()) {
+                        throw std::runtime_error{"Missing source path."};
+                    }
+
+                    const fs::path from = fs::absolute(entry->source);
+
+                    ifs::path to;
+
+                    if (entry->destination.empty()) {
+                        to = _to / from.filename().string();
+                    }
+                    else if (entry->destination.front() == '/') {
+                        to = ifs::path{entry->destination};
+                    }
+                    else {
+                        to = _to / entry->destination;
+                    }
+
+                    to = to.lexically_normal();
+
+                    if (const auto parent = to.parent_path(); !collections.contains(parent.string())) {
+                        collections.ensure(_conn_pool.get_connection(), parent);
+                    }
+
+                    _scheduler.add_small(file_task{from, to});
+                }
+                catch (const std::exception& e) {
+                    ++failures_;
+                    std::cerr << "Error: Manifest record " << entry->record << ": " << e.what() << '\n';
+                }
+            }
+        }
+
+        // Creates the target collections and feeds every regular file to the
+        // scheduler. Files are queued without their size; the worker that picks a
+        // file up stats it and hands it back if it turns out to be large, so the
+        // walk itself never stats a regular file.
+        //
+        // Collections are created by the walker threads as directories are
+        // found, so they are created in parallel and always before any of their
+        // entries are queued. The cache keeps track of the collections that
+        // already exist, which means no collection is sent to the server twice.
+        auto walk_directory(irods::connection_pool& _conn_pool,
+                            scheduler_type& _scheduler,
+                            const fs::path& _from,
+                            const ifs::path& _to,
+                            const put_options& _options) -> void
+        {
+            const auto target = [&_to](const std::string& _rel) { return _rel.empty() ? _to : _to / _rel; };
+
+            collection_cache collections;
+            local_walker::callbacks callbacks;
+
+            callbacks.on_directory = [&](const std::string& _rel) {
+                try {
+                    collections.ensure(_conn_pool.get_connection(), target(_rel));
+                }
+                catch (const std::exception& e) {
+                    report_error(e);
+                }
+            };
+
+            // In sync mode the files of a directory are compared against a single
+            // listing of its collection, fetched when the first file is seen and
+            // dropped once the directory has been scanned. Only the directories
+            // being scanned at the moment hold a listing.
+            std::mutex listings_mtx;
+            std::unordered_map<std::string, collection_listing> listings;
+
+            const auto listing_for = [&](const std::string& _dir) -> const collection_listing& {
+                {
+                    std::lock_guard lk{listings_mtx};
+
+                    if (const auto iter = listings.find(_dir); iter != std::end(listings)) {
+                        return iter->second;
+                    }
+                }
+
+                collection_listing listing;
+
+                if (const auto collection = target(_dir).string(); queryable(collection)) {
+                    try {
+                        listing = list_data_objects(_conn_pool.get_connection(), collection);
+                    }
+                    catch (const std::exception& e) {
+                        std::cerr << "Warning: Cannot list collection; all of its files will be uploaded [path: "
+                                  << collection << "]: " << e.what() << '\n';
+                    }
+                }
+
+                std::lock_guard lk{listings_mtx};
+                return listings.emplace(_dir, std::move(listing)).first->second;
+            };
+
+            const auto up_to_date = [&](const std::string& _rel) {
+                const auto slash = _rel.find_last_of('/');
+                const auto& listing = listing_for(slash == std::string::npos ? std::string{} : _rel.substr(0, slash));
+                const auto iter = listing.find(slash == std::string::npos ? _rel : _rel.substr(slash + 1));
+
+                if (iter == std::end(listing)) {
+                    return false;
+                }
+
+                struct stat st;
+
+                if (::stat((_from / _rel).c_str(), &st) != 0 || static_cast<std::uint64_t>(st.st_size) != iter->second.size) {
+                    return false;
+                }
+
+                // With --checksum the contents decide, whatever the times say. A
+                // data object without a SHA-256 checksum cannot be compared.
+                if (_options.checksum) {
+                    const auto& checksum = iter->second.checksum;
+
+                    if (checksum.compare(0, 5, "sha2:") != 0) {
+                        return false;
+                    }
+
+                    try {
+                        return sha256_digest::to_irods_checksum(digest_of(_from / _rel, _options)) == checksum;
+                    }
+                    catch (const std::exception&) {
+                        return false;
+                    }
+                }
+
+                return st.st_mtim.tv_sec <= iter->second.modify_time;
+            };
+
+            callbacks.on_file = [&](const std::string& _rel) {
+                if (_options.sync && up_to_date(_rel)) {
+                    return;
+                }
+
+                _scheduler.add_small(file_task{_from / _rel, target(_rel)});
+            };
+
+            if (_options.sync) {
+                callbacks.on_directory_done = [&](const std::string& _rel) {
+                    std::lock_guard lk{listings_mtx};
+                    listings.erase(_rel);
+                };
+            }
+
+            callbacks.on_error = [this](const std::string& _path, int _errno) {
+                ++failures_;
+                std::cerr << "Error: Cannot read directory [path: " << _path << ", error: " << std::strerror(_errno)
+                          << "].\n";
+            };
+
+            const auto print_stats = [](const local_walker::stats& _stats) {
+                std::cerr << "Walked " << _stats.directories << " directories, " << _stats.files << " files, "
+                          << _stats.others << " other entries (" << _stats.stat_calls << " stat calls) in "
+                          << _stats.elapsed_seconds << "s [" << static_cast<std::uint64_t>(_stats.entries_per_second())
+                          << " entries/s].\n";
+            };
+
+            if (_options.walk_stats) {
+                callbacks.on_progress = print_stats;
+            }
+
+            local_walker walker{_from.string(), _options.walk_threads};
+            walker.walk(callbacks);
+
+            if (_options.walk_stats) {
+                print_stats(walker.current_stats());
+            }
+        }
+
+        auto transfer_worker(irods::connection_pool& _conn_pool,
+                             scheduler_type& _scheduler,
+                             const put_options& _options) -> void
+        {
+            while (auto work = _scheduler.next()) {
+                switch (work->kind) {
+                    case scheduler_type::work_kind::small: {
+                        // Taking a few more small files at once lets their local reads
+                        // run ahead of the uploads instead of one file at a time.
+                        std::vector<file_task> batch;
+                        batch.push_back(std::move(work->task));
+
+                        while (static_cast<int>(batch.size()) < _options.io_depth) {
+                            auto task = _scheduler.try_next_small();
+
+                            if (!task) {
+                                break;
+                            }
+
+                            batch.push_back(std::move(*task));
+                        }
+
+                        const auto count = batch.size();
+                        put_small_files(_conn_pool, _scheduler, std::move(batch), _options);
+
+                        for (std::size_t i = 0; i < count; ++i) {
+                            _scheduler.complete_small();
+                        }
+
+                        break;
+                    }
+
+                    case scheduler_type::work_kind::lead:
+                        lead_large_file(_conn_pool, _scheduler, work->large, _options);
+                        break;
+
+                    case scheduler_type::work_kind::join:
+                        put_file_chunks(_conn_pool,
+                                        work->large->chunks,
+                                        *work->large->context.token,
+                                        *work->large->context.number,
+                                        work->large->task.from,
+                                        work->large->task.to,
+                                        _options,
+                                        nullptr,
+                                        work->large->context.digest.get());
+                        _scheduler.leave(work->large);
+                        break;
+                }
+            }
+        }
+
+        // Uploads a batch of small files over one connection. The files are
+        // opened up front and their blocks are read through the thread's
+        // async_reader as one sequence, so the reads of the later files are
+        // already in flight while the earlier ones are being sent. Files that
+        // turn out to be large are handed back to the scheduler instead, or led
+        // right away if too many large files are pending already. A file that
+        // fails is left stale and uploaded again on its own once the batch is
+        // done, on a new connection.
+        auto put_small_files(irods::connection_pool& _conn_pool,
+                             scheduler_type& _scheduler,
+                             std::vector<file_task> _tasks,
+                             const put_options& _options) -> void
+        {
+            struct small_file
+            {
+                file_task task;
+                std::unique_ptr<local_file> in;
+                std::optional<sha256_digest> digest;
+                std::uint64_t sent = 0;
+                bool queued = false;
+                bool failed = false;
+                bool retry = false;
+            };
+
+            std::vector<small_file> files;
+            files.reserve(_tasks.size());
+
+            for (auto&& task : _tasks) {
+                try {
+                    auto in = std::make_unique<local_file>(task.from.string(), _options.reading);
+
+                    if (const auto plan = make_transfer_plan(in->size(), _options.tuning); plan.parallel) {
+                        const auto size = in->size();
+                        in.reset();
+
+                        // With the pending large files at their cap, this worker leads one itself.
+                        if (auto large = _scheduler.promote(std::move(task), size, plan.chunk_size, plan.connections); large) {
+                            lead_large_file(_conn_pool, _scheduler, large, _options);
+                        }
+
+                        continue;
+                    }
+
+                    files.push_back({std::move(task), std::move(in)});
+                }
+                catch (const std::exception& e) {
+                    report_error(e);
+                }
+            }
+
+            if (files.empty()) {
+                return;
+            }
+
+            // Mapped files gain nothing from read-ahead.
+            if (files.front().in->mapped()) {
+                for (auto&& f : files) {
+                    put_file(_conn_pool, f.task.from, f.task.to, f.in->size(), _options);
+                }
+
+                return;
+            }
+
+            const auto fail = [&](small_file& _f, const std::exception& _e) {
+                _f.failed = true;
+
+                if (_options.retry.retries > 0) {
+                    _f.retry = true;
+                    std::cerr << "Warning: " << _e.what() << " Retrying the upload [path: " << _f.task.to.string()
+                              << "].\n";
+                }
+                else {
+                    report_error(_e);
+                }
+            };
+
+            try {
+                auto conn = _conn_pool.get_connection();
+
+                auto local_reader = make_reader(_options);
+                const auto block_size = local_reader.block_size();
+
+                std::size_t next_file = 0;
+                std::uint64_t next_offset = 0;
+
+                std::size_t current = files.size();
+                std::optional<io::client::default_transport> tp;
+                std::optional<io::odstream> out;
+
+                const auto finish_current = [&] {
+                    if (out && current < files.size() && files[current].failed) {
+                        close_incomplete(*out);
+                    }
+
+                    out.reset();
+                    tp.reset();
+
+                    if (current >= files.size() || files[current].failed) {
+                        return;
+                    }
+
+                    auto& f = files[current];
+
+                    if (_options.reading.drop_cache) {
+                        f.in->drop_cache(0, f.in->size());
+                    }
+
+                    if (f.digest) {
+                        try {
+                            verify_upload(conn, f.task.to, f.digest->finish());
+                        }
+                        catch (const std::exception& e) {
+                            fail(f, e);
+                        }
+                    }
+                };
+
+                local_reader.run(
+                    [&]() -> std::optional<read_extent> {
+                        while (next_file < files.size()) {
+                            auto& f = files[next_file];
+                            const auto size = f.in->size();
+
+                            // An empty file still needs one (empty) read so that its
+                            // data object gets created in order.
+                            if (next_offset < size || (size == 0 && !f.queued)) {
+                                const auto e = f.in->extent_at(next_offset, size, block_size, next_file);
+                                next_offset = e.offset + std::min<std::uint64_t>(e.length, size - e.offset);
+                                f.queued = true;
+                                return e;
+                            }
+
+                            ++next_file;
+                            next_offset = 0;
+                        }
+
+                        return std::nullopt;
+                    },
+                    [&](const read_extent& _e, const char* _data, std::size_t _size, int _error) {
+                        auto& f = files[_e.tag];
+
+                        try {
+                            if (_e.tag != current) {
+                                finish_current();
+                                current = _e.tag;
+
+                                tp.emplace(conn);
+                                limits_.opens.acquire(1);
+                                out.emplace(*tp, f.task.to);
+
+                                if (!*out) {
+                                    throw std::runtime_error{"Cannot open data object for writing [path: " +
+                                                             f.task.to.string() + "]."};
+                                }
+
+                                if (_options.checksum) {
+                                    f.digest.emplace();
+                                }
+                            }
+
+                            if (f.failed) {
+                                return;
+                            }
+
+                            const auto n = f.in->usable_bytes(_e, _size, _error, f.sent, f.in->size());
+                            send(*out, f.task.to, _data + (f.sent - _e.offset), n);
+
+                            if (f.digest) {
+                                f.digest->update(_data + (f.sent - _e.offset), n);
+                            }
+
+                            f.sent += n;
+                        }
+                        catch (const std::exception& e) {
+                            fail(f, e);
+                        }
+                    });
+
+                finish_current();
+
+                // A failure may have left the connection unusable; the pool opens
+                // a new one in its place.
+                if (std::any_of(std::begin(files), std::end(files), [](const auto& _f) { return _f.failed; })) {
+                    if (auto* comm = conn.release(); comm) {
+                        rcDisconnect(comm);
+                    }
+                }
+            }
+            catch (const std::exception& e) {
+                report_error(e);
+                return;
+            }
+
+            for (auto&& f : files) {
+                if (f.retry) {
+                    put_file(_conn_pool, f.task.from, f.task.to, f.in->size(), _options, 1);
+                }
+            }
+        }
+
+        // Opens and finalizes a large file that other workers help with. Units
+        // its primary stream hands back and no helper takes are sent by the
+        // leader over a joined stream once the helpers are gone; that is the
+        // one time a worker holds two connections, hence the spare one in the
+        // pool.
+        auto lead_large_file(irods::connection_pool& _conn_pool,
+                             scheduler_type& _scheduler,
+                             const scheduler_type::large_pointer& _large,
+                             const put_options& _options) -> void
+        {
+            const auto& [from, to] = _large->task;
+
+            try {
+                auto conn = _conn_pool.get_connection();
+                io::client::default_transport tp{conn};
+                limits_.opens.acquire(1);
+                io::odstream primary{tp, to};
+
+                if (!primary) {
+                    throw std::runtime_error{"Cannot open data object for writing [path: " + to.string() + "]."};
+                }
+
+                _large->context.token = primary.replica_token();
+                _large->context.number = primary.replica_number();
+
+                if (_options.checksum) {
+                    _large->context.digest =
+                        std::make_shared<digest_sequencer>(reorder_limit(_large->chunks.chunk_size(), _options.pool_size));
+                }
+
+                _scheduler.publish(_large);
+
+                bool primary_done = false;
+
+                try {
+                    primary_done = lead_chunks(_large->chunks, from, primary, to, _options, nullptr, _large->context.digest.get());
+                }
+                catch (const std::exception& e) {
+                    report_error(e);
+                }
+
+                // The helper streams must be closed before the primary stream.
+                _scheduler.wait_for_helpers(_large);
+
+                // Units the primary stream handed back that no helper took, e.g.
+                // because every other worker had already left.
+                if (!_large->chunks.exhausted()) {
+                    put_file_chunks(_conn_pool,
+                                    _large->chunks,
+                                    *_large->context.token,
+                                    *_large->context.number,
+                                    from,
+                                    to,
+                                    _options,
+                                    nullptr,
+                                    _large->context.digest.get());
+                }
+
+                const auto complete = _large->chunks.all_done();
+                close_primary(primary, complete);
+
+                if (!complete) {
+                    throw std::runtime_error{"Not every chunk was uploaded; the replica was not marked good [path: " +
+                                             to.string() + "]."};
+                }
+
+                if (const auto& digest = _large->context.digest; digest) {
+                    if (!primary_done) {
+                        verify_upload(conn, to, digest_of(from, _options));
+                    }
+                    else if (const auto d = digest->finish(_large->chunks.total_size()); d) {
+                        verify_upload(conn, to, *d);
+                    }
+                }
+            }
+            catch (const std::exception& e) {
+                report_error(e);
+            }
+
+            _scheduler.finish(_large);
         }
     }; // class put
 } // namespace irods::cli
@@ -1,4 +1,8 @@
 #include "command.hpp"
+#include "collection_listing.hpp"
+#include "collection_traverser.hpp"
+#include "listing_format.hpp"
+#include "listing_writer.hpp"
 
 #include <irods/rodsClient.h>
 #include <irods/connection_pool.hpp>
@@ -67,6 +71,9 @@ namespace irods::cli
         {
             po::options_description options{""};
             options.add_options()
+                ("ordered", "")
+                ("format", po::value<std::string>()->default_value("text"), "")
+                ("connection_pool_size,c", po::value<int>()->default_value(8), "")
                 ("logical_path", po::value<std::string>(), "");
 
             po::positional_options_description positional_options;
@@ -94,7 +101,9 @@ namespace irods::cli
             else {
                 logical_path = env.rodsCwd;
             }
-            auto conn_pool = irods::make_connection_pool();
+            // One connection per traversal thread, on top of this one.
+            const auto threads = std::max(vm["connection_pool_size"].as<int>(), 1);
+            auto conn_pool = irods::make_connection_pool(threads + 1);
             auto conn = conn_pool->get_connection();
 
             const auto s = fs::client::status(conn, logical_path);
@@ -102,12 +111,72 @@ namespace irods::cli
                 std::cerr << "Error: Logical path does not point to a collection or data object.\n";
                 return 1;
             }
-            std::cout << logical_path << ":" << '\n';
-            for(auto&& e = fs::client::recursive_collection_iterator{conn,logical_path}; e != end(e); ++e ) {
-                std::cout << std::setw(e.depth()+1) << ' ' << std::setw(0) << e->path().object_name().c_str() << '\n';
+            const auto format = parse_listing_format(vm["format"].as<std::string>());
+            if(!format) {
+                std::cerr << "Error: Invalid format. Expected text, jsonl, nul or tsv.\n";
+                return 1;
+            }
+
+            listing_writer out;
+
+            if(fs::client::is_data_object(s)) {
+                if(*format == listing_format::text) {
+                    out.print("{}\n", logical_path);
+                }
+                else {
+                    listing_row row;
+                    row.type = "data_object";
+                    row.path = logical_path;
+                    write_row(out, *format, {}, row);
+                }
+                out.flush();
+                return 0;
             }
 
-            return 0;
+            // Collections are listed in parallel. With --ordered they are
+            // printed as a nested tree; otherwise each one is printed as soon as
+            // it has been listed, under its full path, since its parent may not
+            // have been printed yet.
+            const bool ordered = vm.count("ordered") > 0;
+            collection_traverser traverser{*conn_pool, threads, ordered};
+            const auto failures = traverser.run(logical_path,
+                [ordered, format = *format](rcComm_t& c, collection_block& b) {
+                    // Machine-readable rows carry their full path, so the layout does not matter.
+                    if(format != listing_format::text) {
+                        listing_row row;
+                        if(b.depth > 0) {
+                            row.type = "collection";
+                            row.path = b.collection;
+                            write_row(b.out, format, {}, row);
+                        }
+                        std::string path;
+                        row.type = "data_object";
+                        b.subcollections = for_each_entry_in(c, b.collection, [&](const std::string& name) {
+                            join_logical_path(path, b.collection, name);
+                            row.path = path;
+                            write_row(b.out, format, {}, row);
+                        });
+                        return;
+                    }
+                    if(b.depth == 0) {
+                        b.out.print("{}:\n", b.collection);
+                    }
+                    else {
+                        b.out.fill(' ', b.depth);
+                        b.out.print("{}\n", ordered ? fs::path{b.collection}.object_name().string() : b.collection);
+                    }
+                    // Collections GenQuery cannot name are walked entry by entry.
+                    b.subcollections = for_each_entry_in(c, b.collection, [&](const std::string& name) {
+                        b.out.fill(' ', b.depth + 1);
+                        b.out.print("{}\n", name);
+                    });
+                },
+                [&out](std::string_view text) {
+                    out.write(text);
+                });
+            out.flush();
+
+            return failures > 0 ? 1 : 0;
         }
 
     }; // class tree
@@ -0,0 +1,512 @@
+#ifndef IRODS_CLI_ASYNC_IO_HPP
+#define IRODS_CLI_ASYNC_IO_HPP
+
+#include "buffer_pool.hpp"
+
+#include <irods/thread_pool.hpp>
+
+#ifdef IRODS_CLI_HAVE_LIBURING
+#  include <liburing.h>
+#endif
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace irods::cli
+{
+    enum class io_backend
+    {
+        automatic, // io_uring when available, otherwise the I/O thread pool
+        uring,
+        threads,
+        sync // no overlap; every request completes before submit() returns
+    };
+
+    inline auto parse_io_backend(std::string_view _s) -> std::optional<io_backend>
+    {
+        // clang-format off
+        if (_s == "auto")    { return io_backend::automatic; }
+        if (_s == "uring")   { return io_backend::uring; }
+        if (_s == "threads") { return io_backend::threads; }
+        if (_s == "sync")    { return io_backend::sync; }
+        // clang-format on
+
+        return std::nullopt;
+    }
+
+    namespace detail
+    {
+        struct io_request
+        {
+            int fd = -1;
+            char* data = nullptr;
+            std::size_t length = 0;
+            std::int64_t offset = -1; // -1 means "at the current file position"
+            bool write = false;
+
+            long result = 0;
+            int error = 0;
+            bool done = true;
+        };
+
+        // Performs the request synchronously, retrying on EINTR and completing
+        // partial transfers. Reads stop early only at end-of-file.
+        inline auto perform(io_request& _r, std::size_t _already_done = 0) -> void
+        {
+            auto done = _already_done;
+
+            while (done < _r.length) {
+                long n;
+
+                if (_r.write) {
+                    n = _r.offset < 0 ? ::write(_r.fd, _r.data + done, _r.length - done)
+                                      : ::pwrite(_r.fd, _r.data + done, _r.length - done, _r.offset + done);
+                }
+                else {
+                    n = _r.offset < 0 ? ::read(_r.fd, _r.data + done, _r.length - done)
+                                      : ::pread(_r.fd, _r.data + done, _r.length - done, _r.offset + done);
+                }
+
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    _r.error = errno;
+                    break;
+                }
+
+                if (n == 0) {
+                    break;
+                }
+
+                done += static_cast<std::size_t>(n);
+            }
+
+            _r.result = static_cast<long>(done);
+        }
+
+        class io_engine
+        {
+        public:
+            virtual ~io_engine() = default;
+
+            virtual auto submit(io_request& _r) -> void = 0;
+
+            // Blocks until the request has completed.
+            virtual auto wait(io_request& _r) -> void = 0;
+        };
+
+        class sync_engine : public io_engine
+        {
+        public:
+            auto submit(io_request& _r) -> void override
+            {
+                _r.done = false;
+                perform(_r);
+                _r.done = true;
+            }
+
+            auto wait(io_request&) -> void override
+            {
+            }
+        };
+
+        // Shared by every thread-backed engine in the process.
+        inline auto io_thread_pool() -> irods::thread_pool&
+        {
+            static irods::thread_pool pool{static_cast<int>(std::max(4U, std::thread::hardware_concurrency()))};
+            return pool;
+        }
+
+        class thread_engine : public io_engine
+        {
+        public:
+            auto submit(io_request& _r) -> void override
+            {
+                _r.done = false;
+
+                irods::thread_pool::post(io_thread_pool(), [this, &_r] {
+                    perform(_r);
+
+                    // Notify under the lock: once the waiter sees the request as
+                    // done it may destroy this engine.
+                    std::lock_guard lk{mtx_};
+                    _r.done = true;
+                    cv_.notify_all();
+                });
+            }
+
+            auto wait(io_request& _r) -> void override
+            {
+                std::unique_lock lk{mtx_};
+                cv_.wait(lk, [&_r] { return _r.done; });
+            }
+
+        private:
+            std::mutex mtx_;
+            std::condition_variable cv_;
+        };
+
+#ifdef IRODS_CLI_HAVE_LIBURING
+        // One ring per engine. Engines are owned by a single thread, so the ring
+        // needs no locking.
+        class uring_engine : public io_engine
+        {
+        public:
+            explicit uring_engine(unsigned _entries)
+            {
+                if (const auto ec = io_uring_queue_init(std::max(_entries, 2U), &ring_, 0); ec < 0) {
+                    throw std::runtime_error{std::string{"Cannot set up io_uring [error: "} + std::strerror(-ec) + "]."};
+                }
+            }
+
+            ~uring_engine() override
+            {
+                io_uring_queue_exit(&ring_);
+            }
+
+            auto submit(io_request& _r) -> void override
+            {
+                auto* sqe = io_uring_get_sqe(&ring_);
+
+                if (!sqe) {
+                    // The ring is sized for the caller's depth, so this only
+                    // happens if the caller over-submits.
+                    sync_.submit(_r);
+                    return;
+                }
+
+                const auto offset = _r.offset < 0 ? static_cast<__u64>(-1) : static_cast<__u64>(_r.offset);
+
+                if (_r.write) {
+                    io_uring_prep_write(sqe, _r.fd, _r.data, static_cast<unsigned>(_r.length), offset);
+                }
+                else {
+                    io_uring_prep_read(sqe, _r.fd, _r.data, static_cast<unsigned>(_r.length), offset);
+                }
+
+                io_uring_sqe_set_data(sqe, &_r);
+                _r.done = false;
+                io_uring_submit(&ring_);
+            }
+
+            auto wait(io_request& _r) -> void override
+            {
+                while (!_r.done) {
+                    io_uring_cqe* cqe = nullptr;
+
+                    if (const auto ec = io_uring_wait_cqe(&ring_, &cqe); ec < 0) {
+                        if (ec == -EINTR) {
+                            continue;
+                        }
+
+                        throw std::runtime_error{std::string{"Cannot wait for I/O completion [error: "} + std::strerror(-ec) + "]."};
+                    }
+
+                    auto* r = static_cast<io_request*>(io_uring_cqe_get_data(cqe));
+
+                    if (cqe->res < 0) {
+                        r->error = -cqe->res;
+                        r->result = 0;
+                    }
+                    else if (static_cast<std::size_t>(cqe->res) < r->length && cqe->res > 0) {
+                        // Finish short transfers synchronously.
+                        perform(*r, static_cast<std::size_t>(cqe->res));
+                    }
+                    else {
+                        r->result = cqe->res;
+                    }
+
+                    r->done = true;
+                    io_uring_cqe_seen(&ring_, cqe);
+                }
+            }
+
+        private:
+            io_uring ring_{};
+            sync_engine sync_;
+        };
+#endif // IRODS_CLI_HAVE_LIBURING
+
+        inline auto make_io_engine(io_backend _backend, int _depth) -> std::unique_ptr<io_engine>
+        {
+            if (_depth <= 1 || _backend == io_backend::sync) {
+                return std::make_unique<sync_engine>();
+            }
+
+#ifdef IRODS_CLI_HAVE_LIBURING
+            if (_backend == io_backend::uring || _backend == io_backend::automatic) {
+                try {
+                    return std::make_unique<uring_engine>(static_cast<unsigned>(_depth));
+                }
+                catch (const std::exception&) {
+                    // Fall through to the thread pool, e.g. when io_uring is disabled
+                    // by seccomp or an old kernel.
+                }
+            }
+#endif
+
+            return std::make_unique<thread_engine>();
+        }
+    } // namespace detail
+
+    // A piece of a local file to read. The tag is for the caller's bookkeeping.
+    struct read_extent
+    {
+        int fd;
+        std::uint64_t offset;
+        std::size_t length;
+        std::uint64_t tag;
+    };
+
+    // Keeps up to `depth` reads in flight and hands the results back in the order
+    // they were requested. Extents may come from one file (read-ahead) or from
+    // many small files (batched reads). Not thread-safe; use one per thread.
+    class async_reader
+    {
+    public:
+        async_reader(std::size_t _block_size, int _depth, io_backend _backend)
+            : depth_{static_cast<std::size_t>(std::max(_depth, 1))}
+            , backend_{_backend}
+            , engine_{detail::make_io_engine(_backend, _depth)}
+        {
+            slots_.reserve(depth_);
+
+            for (auto&& buffer : buffer_pool::instance().acquire(depth_, _block_size)) {
+                slots_.push_back(std::make_unique<slot>(std::move(buffer)));
+            }
+        }
+
+        async_reader(const async_reader&) = delete;
+        auto operator=(const async_reader&) -> async_reader& = delete;
+
+        ~async_reader()
+        {
+            drain();
+        }
+
+        auto block_size() const noexcept -> std::size_t
+        {
+            return slots_.front()->buffer.size();
+        }
+
+        auto depth() const noexcept -> int
+        {
+            return static_cast<int>(depth_);
+        }
+
+        auto backend() const noexcept -> io_backend
+        {
+            return backend_;
+        }
+
+        // Calls _next() for extents (std::optional<read_extent>, each no longer
+        // than the block size) until it returns an empty optional, and calls
+        // _sink(const read_extent&, const char*, std::size_t, int) for each
+        // completed read, in order. The last argument is the errno of a failed
+        // read, or zero. A read that hits end-of-file early delivers fewer bytes.
+        template <typename Next, typename Sink>
+        auto run(Next&& _next, Sink&& _sink) -> void
+        {
+            std::size_t head = 0;
+            std::size_t in_flight = 0;
+            bool exhausted = false;
+
+            const auto fill = [&] {
+                while (!exhausted && in_flight < depth_) {
+                    auto e = _next();
+
+                    if (!e) {
+                        exhausted = true;
+                        break;
+                    }
+
+                    auto& s = *slots_[(head + in_flight) % depth_];
+                    s.extent = *e;
+                    s.request = detail::io_request{};
+                    s.request.fd = e->fd;
+                    s.request.data = s.buffer.data();
+                    s.request.length = std::min(e->length, s.buffer.size());
+                    s.request.offset = static_cast<std::int64_t>(e->offset);
+                    s.pending = true;
+                    engine_->submit(s.request);
+                    ++in_flight;
+                }
+            };
+
+            fill();
+
+            while (in_flight > 0) {
+                auto& s = *slots_[head];
+                engine_->wait(s.request);
+                s.pending = false;
+
+                head = (head + 1) % depth_;
+                --in_flight;
+
+                _sink(s.extent, s.buffer.data(), static_cast<std::size_t>(s.request.result), s.request.error);
+                fill();
+            }
+        }
+
+    private:
+        struct slot
+        {
+            explicit slot(aligned_buffer _buffer)
+                : buffer{std::move(_buffer)}
+            {
+            }
+
+            aligned_buffer buffer;
+            read_extent extent{};
+            detail::io_request request;
+            bool pending = false;
+        };
+
+        // Requests must not outlive their buffers, e.g. when a sink throws.
+        auto drain() noexcept -> void
+        {
+            for (auto&& s : slots_) {
+                if (s->pending) {
+                    try {
+                        engine_->wait(s->request);
+                    }
+                    catch (...) {
+                    }
+
+                    s->pending = false;
+                }
+            }
+        }
+
+        const std::size_t depth_;
+        const io_backend backend_;
+        std::unique_ptr<detail::io_engine> engine_;
+        std::vector<std::unique_ptr<slot>> slots_;
+    }; // class async_reader
+
+    // Overlaps local writes with whatever produces the data. The caller fills the
+    // buffer returned by acquire() and hands it back with submit(). Positional
+    // writes keep up to `depth` requests in flight; stream writes (e.g. stdout)
+    // keep one in flight so the output stays in order. Not thread-safe.
+    class async_writer
+    {
+    public:
+        async_writer(int _fd, std::size_t _block_size, int _depth, io_backend _backend)
+            : fd_{_fd}
+            , depth_{static_cast<std::size_t>(std::max(_depth, 2))}
+            , engine_{detail::make_io_engine(_backend, _depth)}
+        {
+            slots_.reserve(depth_);
+
+            for (auto&& buffer : buffer_pool::instance().acquire(depth_, _block_size)) {
+                slots_.push_back(std::make_unique<slot>(std::move(buffer)));
+            }
+        }
+
+        async_writer(const async_writer&) = delete;
+        auto operator=(const async_writer&) -> async_writer& = delete;
+
+        ~async_writer()
+        {
+            for (auto&& s : slots_) {
+                if (s->pending) {
+                    try {
+                        engine_->wait(s->request);
+                    }
+                    catch (...) {
+                    }
+                }
+            }
+        }
+
+        // Returns the next free buffer, waiting for its previous write if needed.
+        auto acquire() -> aligned_buffer&
+        {
+            auto& s = *slots_[next_];
+            complete(s);
+            return s.buffer;
+        }
+
+        // Writes the first _size bytes of the buffer returned by the last call to
+        // acquire(). A negative offset appends at the current file position.
+        auto submit(std::size_t _size, std::int64_t _offset = -1) -> void
+        {
+            auto& s = *slots_[next_];
+
+            if (_offset < 0 && last_ != nullptr) {
+                complete(*last_);
+            }
+
+            s.request = detail::io_request{};
+            s.request.fd = fd_;
+            s.request.data = s.buffer.data();
+            s.request.length = _size;
+            s.request.offset = _offset;
+            s.request.write = true;
+            s.pending = true;
+            engine_->submit(s.request);
+
+            last_ = &s;
+            next_ = (next_ + 1) % depth_;
+        }
+
+        // Waits for every outstanding write and reports the first error.
+        auto flush() -> void
+        {
+            for (std::size_t i = 0; i < depth_; ++i) {
+                complete(*slots_[(next_ + i) % depth_]);
+            }
+        }
+
+    private:
+        struct slot
+        {
+            explicit slot(aligned_buffer _buffer)
+                : buffer{std::move(_buffer)}
+            {
+            }
+
+            aligned_buffer buffer;
+            detail::io_request request;
+            bool pending = false;
+        };
+
+        auto complete(slot& _s) -> void
+        {
+            if (!_s.pending) {
+                return;
+            }
+
+            engine_->wait(_s.request);
+            _s.pending = false;
+
+            if (_s.request.error != 0) {
+                throw std::runtime_error{std::string{"Write failed [error: "} + std::strerror(_s.request.error) + "]."};
+            }
+        }
+
+        const int fd_;
+        const std::size_t depth_;
+        std::unique_ptr<detail::io_engine> engine_;
+        std::vector<std::unique_ptr<slot>> slots_;
+        std::size_t next_ = 0;
+        slot* last_ = nullptr;
+    }; // class async_writer
+} // namespace irods::cli
+
+#endif // IRODS_CLI_ASYNC_IO_HPP
@@ -0,0 +1,154 @@
+#ifndef IRODS_CLI_BOUNDED_QUEUE_HPP
+#define IRODS_CLI_BOUNDED_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace irods::cli
+{
+    // A fixed-capacity, lock-free, multi-producer/multi-consumer FIFO queue
+    // (Dmitry Vyukov's bounded MPMC ring). Each slot carries a sequence number
+    // that tells producers and consumers whose turn it is, so neither side ever
+    // takes a lock. The capacity is rounded up to a power of two.
+    template <typename T>
+    class bounded_queue
+    {
+    public:
+        explicit bounded_queue(std::size_t _capacity)
+            : mask_{round_up_to_power_of_two(_capacity) - 1}
+            , cells_{std::make_unique<cell[]>(mask_ + 1)}
+            , enqueue_pos_{0}
+            , dequeue_pos_{0}
+        {
+            for (std::size_t i = 0; i <= mask_; ++i) {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bounded_queue(const bounded_queue&) = delete;
+        auto operator=(const bounded_queue&) -> bounded_queue& = delete;
+
+        // Returns false without consuming the value if the queue is full.
+        auto try_push(T&& _value) -> bool
+        {
+            auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+            cell* c;
+
+            for (;;) {
+                c = &cells_[pos & mask_];
+                const auto seq = c->sequence.load(std::memory_order_acquire);
+                const auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+
+                if (dif == 0) {
+                    if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                else if (dif < 0) {
+                    return false;
+                }
+                else {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+
+            c->value = std::move(_value);
+            c->sequence.store(pos + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // Returns false if the queue is empty.
+        auto try_pop(T& _value) -> bool
+        {
+            auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+            cell* c;
+
+            for (;;) {
+                c = &cells_[pos & mask_];
+                const auto seq = c->sequence.load(std::memory_order_acquire);
+                const auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+
+                if (dif == 0) {
+                    if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                else if (dif < 0) {
+                    return false;
+                }
+                else {
+                    pos = dequeue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+
+            _value = std::move(c->value);
+            c->sequence.store(pos + mask_ + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // Blocks the producer while the queue is full. This is the backpressure
+        // that keeps a fast producer from running ahead of its consumers.
+        auto push(T&& _value) -> void
+        {
+            for (int attempt = 0; !try_push(std::move(_value)); ++attempt) {
+                backoff(attempt);
+            }
+        }
+
+        // Only a hint while other threads are pushing or popping.
+        auto size_approx() const noexcept -> std::size_t
+        {
+            const auto enqueued = enqueue_pos_.load(std::memory_order_relaxed);
+            const auto dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+            return enqueued > dequeued ? enqueued - dequeued : 0;
+        }
+
+        auto capacity() const noexcept -> std::size_t
+        {
+            return mask_ + 1;
+        }
+
+    private:
+        struct cell
+        {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        static auto round_up_to_power_of_two(std::size_t _n) noexcept -> std::size_t
+        {
+            std::size_t n = 2;
+
+            while (n < _n) {
+                n <<= 1;
+            }
+
+            return n;
+        }
+
+        static auto backoff(int _attempt) -> void
+        {
+            if (_attempt < 64) {
+                std::this_thread::yield();
+            }
+            else {
+                std::this_thread::sleep_for(std::chrono::microseconds{std::min(_attempt, 1000)});
+            }
+        }
+
+        const std::size_t mask_;
+        std::unique_ptr<cell[]> cells_;
+        alignas(64) std::atomic<std::size_t> enqueue_pos_;
+        alignas(64) std::atomic<std::size_t> dequeue_pos_;
+    }; // class bounded_queue
+} // namespace irods::cli
+
+#endif // IRODS_CLI_BOUNDED_QUEUE_HPP
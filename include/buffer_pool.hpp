@@ -0,0 +1,265 @@
+#ifndef IRODS_CLI_BUFFER_POOL_HPP
+#define IRODS_CLI_BUFFER_POOL_HPP
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace irods::cli
+{
+    class buffer_pool;
+
+    // A page-aligned transfer buffer on loan from the buffer_pool. It goes back
+    // to the pool when it is destroyed. The alignment suits O_DIRECT.
+    class aligned_buffer
+    {
+    public:
+        static constexpr std::size_t alignment = 4096;
+
+        aligned_buffer(aligned_buffer&& _other) noexcept
+            : pool_{std::exchange(_other.pool_, nullptr)}
+            , data_{std::exchange(_other.data_, nullptr)}
+            , size_{std::exchange(_other.size_, 0)}
+        {
+        }
+
+        auto operator=(aligned_buffer&& _other) noexcept -> aligned_buffer&
+        {
+            if (this != &_other) {
+                reset();
+                pool_ = std::exchange(_other.pool_, nullptr);
+                data_ = std::exchange(_other.data_, nullptr);
+                size_ = std::exchange(_other.size_, 0);
+            }
+
+            return *this;
+        }
+
+        ~aligned_buffer()
+        {
+            reset();
+        }
+
+        auto data() noexcept -> char*
+        {
+            return data_;
+        }
+
+        auto data() const noexcept -> const char*
+        {
+            return data_;
+        }
+
+        auto size() const noexcept -> std::size_t
+        {
+            return size_;
+        }
+
+    private:
+        friend class buffer_pool;
+
+        aligned_buffer(buffer_pool* _pool, char* _data, std::size_t _size) noexcept
+            : pool_{_pool}
+            , data_{_data}
+            , size_{_size}
+        {
+        }
+
+        inline auto reset() noexcept -> void;
+
+        buffer_pool* pool_;
+        char* data_;
+        std::size_t size_;
+    }; // class aligned_buffer
+
+    // The process-wide source of transfer buffers.
+    //
+    // Buffers are mapped straight from the kernel, so they are page-aligned and
+    // may be backed by transparent huge pages. Returned buffers are kept and
+    // handed out again, so the streams of a job share one set of buffers instead
+    // of each thread allocating its own.
+    //
+    // With a memory limit, an acquisition waits while the buffers on loan plus
+    // the ones requested would exceed it; cached buffers of other sizes are
+    // unmapped to make room. A component takes all the buffers it needs in one
+    // acquisition (e.g. a reader takes one per read it keeps in flight), so two
+    // components never hold part of what they need while waiting for the rest.
+    // A request larger than the limit is granted once nothing else is on loan.
+    class buffer_pool
+    {
+    public:
+        static auto instance() -> buffer_pool&
+        {
+            // Never destroyed, so buffers may be returned during static destruction.
+            static auto* pool = new buffer_pool;
+            return *pool;
+        }
+
+        buffer_pool(const buffer_pool&) = delete;
+        auto operator=(const buffer_pool&) -> buffer_pool& = delete;
+
+        // A memory limit of zero means unlimited. Applies to later acquisitions.
+        auto configure(std::uint64_t _memory_limit, bool _huge_pages) -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                memory_limit_ = _memory_limit;
+                huge_pages_ = _huge_pages;
+                trim(0);
+            }
+
+            cv_.notify_all();
+        }
+
+        // Zero if unlimited.
+        auto memory_limit() -> std::uint64_t
+        {
+            std::lock_guard lk{mtx_};
+            return memory_limit_;
+        }
+
+        // Returns _count buffers of at least _size bytes each.
+        auto acquire(std::size_t _count, std::size_t _size) -> std::vector<aligned_buffer>
+        {
+            std::unique_lock lk{mtx_};
+
+            const auto size = round_up(_size);
+            const auto needed = static_cast<std::uint64_t>(_count) * size;
+
+            cv_.wait(lk, [&] { return memory_limit_ == 0 || lent_ == 0 || lent_ + needed <= memory_limit_; });
+
+            std::vector<aligned_buffer> buffers;
+            buffers.reserve(_count);
+
+            auto& cached = free_[size];
+
+            while (buffers.size() < _count && !cached.empty()) {
+                buffers.push_back(aligned_buffer{this, cached.back(), size});
+                cached.pop_back();
+                cached_ -= size;
+                lent_ += size;
+            }
+
+            if (buffers.size() < _count) {
+                trim(static_cast<std::uint64_t>(_count - buffers.size()) * size);
+            }
+
+            try {
+                while (buffers.size() < _count) {
+                    buffers.push_back(aligned_buffer{this, map(size), size});
+                    lent_ += size;
+                }
+            }
+            catch (...) {
+                // The buffers taken so far are returned on the way out.
+                lk.unlock();
+                throw;
+            }
+
+            return buffers;
+        }
+
+        auto acquire(std::size_t _size) -> aligned_buffer
+        {
+            return std::move(acquire(1, _size).front());
+        }
+
+    private:
+        friend class aligned_buffer;
+
+        static constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+        buffer_pool() = default;
+
+        auto round_up(std::size_t _size) const noexcept -> std::size_t
+        {
+            const auto unit = huge_pages_ ? huge_page_size : aligned_buffer::alignment;
+            return (std::max<std::size_t>(_size, 1) + unit - 1) / unit * unit;
+        }
+
+        auto map(std::size_t _size) -> char*
+        {
+            auto* p = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (p == MAP_FAILED) {
+                throw std::bad_alloc{};
+            }
+
+#ifdef MADV_HUGEPAGE
+            if (huge_pages_) {
+                ::madvise(p, _size, MADV_HUGEPAGE);
+            }
+#endif
+
+            return static_cast<char*>(p);
+        }
+
+        // Unmaps cached buffers until _incoming more bytes fit under the limit.
+        // Expects the mutex to be held.
+        auto trim(std::uint64_t _incoming) noexcept -> void
+        {
+            if (memory_limit_ == 0) {
+                return;
+            }
+
+            for (auto iter = std::begin(free_); iter != std::end(free_) && lent_ + cached_ + _incoming > memory_limit_;) {
+                auto& [size, cached] = *iter;
+
+                while (!cached.empty() && lent_ + cached_ + _incoming > memory_limit_) {
+                    ::munmap(cached.back(), size);
+                    cached.pop_back();
+                    cached_ -= size;
+                }
+
+                iter = cached.empty() ? free_.erase(iter) : std::next(iter);
+            }
+        }
+
+        auto release(char* _data, std::size_t _size) noexcept -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                lent_ -= _size;
+
+                try {
+                    free_[_size].push_back(_data);
+                    cached_ += _size;
+                }
+                catch (...) {
+                    ::munmap(_data, _size);
+                }
+
+                trim(0);
+            }
+
+            cv_.notify_all();
+        }
+
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        std::uint64_t memory_limit_ = 0;
+        bool huge_pages_ = false;
+        std::uint64_t lent_ = 0;
+        std::uint64_t cached_ = 0;
+        std::unordered_map<std::size_t, std::vector<char*>> free_;
+    }; // class buffer_pool
+
+    inline auto aligned_buffer::reset() noexcept -> void
+    {
+        if (pool_) {
+            pool_->release(data_, size_);
+            pool_ = nullptr;
+        }
+    }
+} // namespace irods::cli
+
+#endif // IRODS_CLI_BUFFER_POOL_HPP
@@ -0,0 +1,205 @@
+#ifndef IRODS_CLI_BUFFER_RING_HPP
+#define IRODS_CLI_BUFFER_RING_HPP
+
+#include "buffer_pool.hpp"
+
+#include <irods/thread_pool.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace irods::cli
+{
+    // A fixed set of buffers handed back and forth between one producer thread
+    // and one consumer thread. The producer fills empty buffers while the
+    // consumer drains filled ones, so both sides run at the same time and
+    // memory never exceeds count * size.
+    //
+    // Every operation takes a mutex, so several consumers may share the ring
+    // as long as they do not depend on the order in which buffers are drained.
+    class buffer_ring
+    {
+    public:
+        struct slot
+        {
+            explicit slot(aligned_buffer _buffer)
+                : buffer{std::move(_buffer)}
+            {
+            }
+
+            aligned_buffer buffer;
+            std::size_t size = 0;
+
+            // Position of the data in the stream, for consumers that write out of order.
+            std::uint64_t offset = 0;
+        };
+
+        buffer_ring(std::size_t _count, std::size_t _buffer_size)
+        {
+            const auto count = std::max<std::size_t>(_count, 2);
+            slots_.reserve(count);
+
+            for (auto&& buffer : buffer_pool::instance().acquire(count, _buffer_size)) {
+                slots_.push_back(std::make_unique<slot>(std::move(buffer)));
+                empty_.push_back(slots_.back().get());
+            }
+        }
+
+        buffer_ring(const buffer_ring&) = delete;
+        auto operator=(const buffer_ring&) -> buffer_ring& = delete;
+
+        auto buffer_size() const noexcept -> std::size_t
+        {
+            return slots_.front()->buffer.size();
+        }
+
+        // Producer side. Returns nullptr once the ring has been cancelled.
+        auto acquire_empty() -> slot*
+        {
+            return pop(empty_);
+        }
+
+        auto push_filled(slot* _slot) -> void
+        {
+            push(filled_, _slot);
+        }
+
+        // Producer side. No more buffers will be filled.
+        auto close() -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                closed_ = true;
+            }
+
+            cv_.notify_all();
+        }
+
+        // Consumer side. Returns nullptr once every filled buffer has been
+        // consumed and the producer has closed the ring, or on cancellation.
+        auto acquire_filled() -> slot*
+        {
+            return pop(filled_);
+        }
+
+        auto push_empty(slot* _slot) -> void
+        {
+            push(empty_, _slot);
+        }
+
+        // Either side. Wakes up and stops the other side, e.g. after an error.
+        auto cancel() -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                cancelled_ = true;
+            }
+
+            cv_.notify_all();
+        }
+
+    private:
+        auto pop(std::deque<slot*>& _from) -> slot*
+        {
+            std::unique_lock lk{mtx_};
+
+            // Only the filled side ends when the ring is closed; the producer is
+            // the one that closed it.
+            cv_.wait(lk, [&] { return cancelled_ || !_from.empty() || (closed_ && &_from == &filled_); });
+
+            if (cancelled_ || _from.empty()) {
+                return nullptr;
+            }
+
+            auto* s = _from.front();
+            _from.pop_front();
+
+            return s;
+        }
+
+        auto push(std::deque<slot*>& _to, slot* _slot) -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                _to.push_back(_slot);
+            }
+
+            cv_.notify_all();
+        }
+
+        std::vector<std::unique_ptr<slot>> slots_;
+
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        std::deque<slot*> empty_;
+        std::deque<slot*> filled_;
+        bool closed_ = false;
+        bool cancelled_ = false;
+    }; // class buffer_ring
+
+    // Moves a stream through a buffer_ring. _produce(buffer_ring::slot&) runs on
+    // a reader thread; it fills the slot (setting its size) and returns false at
+    // the end of the input. _consume(const buffer_ring::slot&) runs on the
+    // calling thread. An exception from either side stops both and is rethrown.
+    template <typename Produce, typename Consume>
+    auto pipe_through(buffer_ring& _ring, Produce&& _produce, Consume&& _consume) -> void
+    {
+        std::exception_ptr producer_error;
+        irods::thread_pool reader{1};
+
+        irods::thread_pool::post(reader, [&] {
+            try {
+                for (bool more = true; more;) {
+                    auto* s = _ring.acquire_empty();
+
+                    if (!s) {
+                        return;
+                    }
+
+                    s->size = 0;
+                    more = _produce(*s);
+
+                    if (s->size > 0) {
+                        _ring.push_filled(s);
+                    }
+                    else {
+                        _ring.push_empty(s);
+                    }
+                }
+
+                _ring.close();
+            }
+            catch (...) {
+                producer_error = std::current_exception();
+                _ring.cancel();
+            }
+        });
+
+        try {
+            while (auto* s = _ring.acquire_filled()) {
+                _consume(*s);
+                _ring.push_empty(s);
+            }
+        }
+        catch (...) {
+            _ring.cancel();
+            reader.join();
+            throw;
+        }
+
+        reader.join();
+
+        if (producer_error) {
+            std::rethrow_exception(producer_error);
+        }
+    }
+} // namespace irods::cli
+
+#endif // IRODS_CLI_BUFFER_RING_HPP
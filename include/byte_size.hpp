@@ -0,0 +1,78 @@
+#ifndef IRODS_CLI_BYTE_SIZE_HPP
+#define IRODS_CLI_BYTE_SIZE_HPP
+
+#include <cctype>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace irods::cli
+{
+    // clang-format off
+    inline constexpr std::uint64_t kibibyte = 1024;
+    inline constexpr std::uint64_t mebibyte = 1024 * kibibyte;
+    inline constexpr std::uint64_t gibibyte = 1024 * mebibyte;
+    inline constexpr std::uint64_t tebibyte = 1024 * gibibyte;
+    // clang-format on
+
+    // Parses sizes such as "4096", "64K", "32M", "2G" or "1T" (binary units,
+    // case-insensitive, optional trailing "B" or "iB"). Returns an empty optional
+    // if the string is not a valid size or does not fit in 64 bits.
+    inline auto parse_byte_size(std::string_view _s) -> std::optional<std::uint64_t>
+    {
+        std::uint64_t value = 0;
+        std::size_t i = 0;
+
+        constexpr auto max = std::numeric_limits<std::uint64_t>::max();
+
+        for (; i < _s.size() && std::isdigit(static_cast<unsigned char>(_s[i])); ++i) {
+            const auto digit = static_cast<std::uint64_t>(_s[i] - '0');
+
+            if (value > (max - digit) / 10) {
+                return std::nullopt;
+            }
+
+            value = value * 10 + digit;
+        }
+
+        if (i == 0) {
+            return std::nullopt;
+        }
+
+        auto suffix = std::string{_s.substr(i)};
+
+        for (auto& c : suffix) {
+            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+
+        if (suffix.empty() || suffix == "B") {
+            return value;
+        }
+
+        std::uint64_t multiplier = 0;
+
+        switch (suffix[0]) {
+            // clang-format off
+            case 'K': multiplier = kibibyte; break;
+            case 'M': multiplier = mebibyte; break;
+            case 'G': multiplier = gibibyte; break;
+            case 'T': multiplier = tebibyte; break;
+            default:  return std::nullopt;
+            // clang-format on
+        }
+
+        if (const auto rest = suffix.substr(1); !rest.empty() && rest != "B" && rest != "IB") {
+            return std::nullopt;
+        }
+
+        if (value > max / multiplier) {
+            return std::nullopt;
+        }
+
+        return value * multiplier;
+    }
+} // namespace irods::cli
+
+#endif // IRODS_CLI_BYTE_SIZE_HPP
@@ -0,0 +1,223 @@
+#ifndef IRODS_CLI_CHUNK_SCHEDULER_HPP
+#define IRODS_CLI_CHUNK_SCHEDULER_HPP
+
+#include "byte_size.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace irods::cli
+{
+    struct chunk
+    {
+        std::uint64_t index;
+        std::uint64_t offset;
+        std::uint64_t size;
+    };
+
+    // Splits [0, total size) into fixed-size units of work. Any number of workers
+    // may call next() concurrently; each unit is handed out once and in
+    // ascending order, so a slow worker only ever holds up the unit it is on.
+    //
+    // A worker that cannot finish a unit may hand it back with requeue(); it
+    // is handed out again before any unit that was never handed out. Workers
+    // report finished units with mark_done(), which tells whether the whole
+    // range made it.
+    class chunk_scheduler
+    {
+    public:
+        chunk_scheduler(std::uint64_t _total_size, std::uint64_t _chunk_size) noexcept
+            : total_size_{_total_size}
+            , chunk_size_{std::max<std::uint64_t>(_chunk_size, 1)}
+            , chunk_count_{(_total_size + chunk_size_ - 1) / chunk_size_}
+            , next_{0}
+        {
+        }
+
+        chunk_scheduler(const chunk_scheduler&) = delete;
+        auto operator=(const chunk_scheduler&) -> chunk_scheduler& = delete;
+
+        // Excludes units that are already done, e.g. by an earlier transfer that
+        // was interrupted. Must be called before the first call to next().
+        auto skip(std::vector<bool> _done) -> void
+        {
+            done_ = std::move(_done);
+
+            for (std::uint64_t i = 0; i < std::min<std::uint64_t>(done_.size(), chunk_count_); ++i) {
+                if (done_[i]) {
+                    ++skipped_;
+                }
+            }
+        }
+
+        auto next() -> std::optional<chunk>
+        {
+            // Units handed back are rare, so the mutex is only taken when there are any.
+            if (requeued_count_.load(std::memory_order_acquire) > 0) {
+                std::lock_guard lk{mtx_};
+
+                if (!requeued_.empty()) {
+                    const auto c = requeued_.back();
+                    requeued_.pop_back();
+                    requeued_count_.fetch_sub(1, std::memory_order_release);
+                    return c;
+                }
+            }
+
+            for (;;) {
+                const auto i = next_.fetch_add(1, std::memory_order_relaxed);
+
+                if (i >= chunk_count_) {
+                    return std::nullopt;
+                }
+
+                if (i < done_.size() && done_[i]) {
+                    continue;
+                }
+
+                const auto offset = i * chunk_size_;
+
+                return chunk{i, offset, std::min(chunk_size_, total_size_ - offset)};
+            }
+        }
+
+        // Hands a unit that was taken with next() back to the other workers.
+        auto requeue(const chunk& _chunk) -> void
+        {
+            std::lock_guard lk{mtx_};
+            requeued_.push_back(_chunk);
+            requeued_count_.fetch_add(1, std::memory_order_release);
+        }
+
+        auto mark_done(const chunk&) noexcept -> void
+        {
+            completed_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // True if every unit was either skipped or marked done.
+        auto all_done() const noexcept -> bool
+        {
+            return skipped_ + completed_.load(std::memory_order_relaxed) >= chunk_count_;
+        }
+
+        // True once every unit has been handed out. Units may still be in flight.
+        auto exhausted() const noexcept -> bool
+        {
+            return next_.load(std::memory_order_relaxed) >= chunk_count_ &&
+                   requeued_count_.load(std::memory_order_acquire) == 0;
+        }
+
+        auto total_size() const noexcept -> std::uint64_t
+        {
+            return total_size_;
+        }
+
+        auto chunk_size() const noexcept -> std::uint64_t
+        {
+            return chunk_size_;
+        }
+
+        auto chunk_count() const noexcept -> std::uint64_t
+        {
+            return chunk_count_;
+        }
+
+    private:
+        const std::uint64_t total_size_;
+        const std::uint64_t chunk_size_;
+        const std::uint64_t chunk_count_;
+        std::atomic<std::uint64_t> next_;
+        std::vector<bool> done_;
+        std::uint64_t skipped_ = 0;
+        std::atomic<std::uint64_t> completed_{0};
+
+        std::mutex mtx_;
+        std::vector<chunk> requeued_;
+        std::atomic<std::size_t> requeued_count_{0};
+    }; // class chunk_scheduler
+
+    // User-facing knobs for parallel transfers. A zero value means "derive it".
+    struct transfer_tuning
+    {
+        int connections = 0;
+        std::uint64_t chunk_size = 0;
+        double link_speed_gbps = 10.0;
+    };
+
+    struct transfer_plan
+    {
+        bool parallel;
+        int connections;
+        std::uint64_t chunk_size;
+    };
+
+    // Decides how a file of the given size should be moved.
+    //
+    // A single TCP stream to an iRODS server rarely exceeds a few Gbit/s, so the
+    // connection count grows with the link speed. Chunks are sized so that each
+    // connection moves roughly a quarter second of its share of the link per
+    // unit, and are shrunk for smaller files so every connection gets several
+    // units to steal. Files smaller than two chunks are not worth the extra opens.
+    inline auto make_transfer_plan(std::uint64_t _file_size, const transfer_tuning& _tuning) -> transfer_plan
+    {
+        constexpr double per_stream_gbps = 2.5;
+        constexpr std::uint64_t min_chunk_size = 8 * mebibyte;
+        constexpr std::uint64_t max_chunk_size = 256 * mebibyte;
+        constexpr std::uint64_t min_parallel_size = 32 * mebibyte;
+        constexpr std::uint64_t units_per_connection = 4;
+
+        const auto link_gbps = std::max(_tuning.link_speed_gbps, 0.1);
+        const auto link_bytes_per_second = static_cast<std::uint64_t>(link_gbps * 1e9 / 8);
+
+        int connections = _tuning.connections;
+
+        if (connections <= 0) {
+            connections = std::clamp(static_cast<int>(std::ceil(link_gbps / per_stream_gbps)), 2, 16);
+        }
+
+        std::uint64_t chunk_size = _tuning.chunk_size;
+
+        if (chunk_size == 0) {
+            const auto per_connection = link_bytes_per_second / 4 / static_cast<std::uint64_t>(connections);
+            const auto fair_share = _file_size / (units_per_connection * static_cast<std::uint64_t>(connections));
+
+            chunk_size = std::clamp(std::min(per_connection, fair_share), min_chunk_size, max_chunk_size);
+            chunk_size -= chunk_size % mebibyte;
+        }
+
+        if (_file_size < std::max(min_parallel_size, 2 * chunk_size)) {
+            return {false, 1, _file_size};
+        }
+
+        const auto chunk_count = (_file_size + chunk_size - 1) / chunk_size;
+        connections = static_cast<int>(std::min<std::uint64_t>(static_cast<std::uint64_t>(connections), chunk_count));
+
+        return {true, connections, chunk_size};
+    }
+
+    // Decides how a stream of unknown length, such as stdin, should be moved.
+    //
+    // With a size hint the stream is planned like a file of that size. Without
+    // one it stays on a single connection unless more were asked for, and its
+    // segments are sized from the link alone, as if the stream were endless.
+    inline auto make_stream_plan(std::uint64_t _size_hint, const transfer_tuning& _tuning) -> transfer_plan
+    {
+        if (_size_hint > 0) {
+            return make_transfer_plan(_size_hint, _tuning);
+        }
+
+        if (_tuning.connections <= 1) {
+            return {false, 1, 0};
+        }
+
+        return make_transfer_plan(std::numeric_limits<std::uint64_t>::max() / 2, _tuning);
+    }
+} // namespace irods::cli
+
+#endif // IRODS_CLI_CHUNK_SCHEDULER_HPP
@@ -0,0 +1,75 @@
+#ifndef IRODS_CLI_COLLECTION_CACHE_HPP
+#define IRODS_CLI_COLLECTION_CACHE_HPP
+
+#include <irods/rodsClient.h>
+#include <irods/filesystem.hpp>
+
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+namespace irods::cli
+{
+    // Remembers which collections are known to exist so that a recursive upload
+    // asks the server about each collection at most once.
+    //
+    // ensure() creates missing parents before their children. A collection is
+    // created with a single rcCollCreate call instead of the exists-then-create
+    // sequence of filesystem::client::create_collections, which also re-checks
+    // every ancestor. The cache is shared by all threads of a job.
+    class collection_cache
+    {
+    public:
+        using path = irods::experimental::filesystem::path;
+
+        collection_cache() = default;
+
+        collection_cache(const collection_cache&) = delete;
+        auto operator=(const collection_cache&) -> collection_cache& = delete;
+
+        auto ensure(rcComm_t& _comm, const path& _path) -> void
+        {
+            const auto key = _path.string();
+
+            if (key.empty() || key == "/" || contains(key)) {
+                return;
+            }
+
+            ensure(_comm, _path.parent_path());
+            create(_comm, key);
+
+            std::lock_guard lk{mtx_};
+            known_.insert(key);
+        }
+
+        auto contains(const std::string& _path) const -> bool
+        {
+            std::shared_lock lk{mtx_};
+            return known_.count(_path) > 0;
+        }
+
+    private:
+        static auto create(rcComm_t& _comm, const std::string& _path) -> void
+        {
+            collInp_t input{};
+            rstrcpy(input.collName, _path.c_str(), MAX_NAME_LEN);
+
+            if (const auto ec = rcCollCreate(&_comm, &input); ec >= 0 || ec == CATALOG_ALREADY_HAS_ITEM_BY_THAT_NAME) {
+                return;
+            }
+
+            // Creating an ancestor such as the zone collection is not permitted, but
+            // that is fine as long as it exists.
+            if (!irods::experimental::filesystem::client::is_collection(_comm, _path)) {
+                throw std::runtime_error{"Cannot create collection [path: " + _path + "]."};
+            }
+        }
+
+        mutable std::shared_mutex mtx_;
+        std::unordered_set<std::string> known_;
+    }; // class collection_cache
+} // namespace irods::cli
+
+#endif // IRODS_CLI_COLLECTION_CACHE_HPP
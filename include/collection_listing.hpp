@@ -0,0 +1,340 @@
+#ifndef IRODS_CLI_COLLECTION_LISTING_HPP
+#define IRODS_CLI_COLLECTION_LISTING_HPP
+
+#include <irods/rodsClient.h>
+#include <irods/filesystem.hpp>
+#include <irods/irods_query.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace irods::cli
+{
+    // Catalog information about one data object. With several good replicas,
+    // the most recently modified one is described.
+    struct data_object_info
+    {
+        std::uint64_t size = 0;
+        std::int64_t modify_time = 0; // Seconds since the epoch.
+        std::string checksum;
+    };
+
+    // Data objects of one collection, keyed by name.
+    using collection_listing = std::unordered_map<std::string, data_object_info>;
+
+    // GenQuery has no way to escape quotes inside a condition, so such names
+    // cannot be queried.
+    inline auto queryable(const std::string& _collection) noexcept -> bool
+    {
+        return _collection.find('\'') == std::string::npos;
+    }
+
+    // Fetches the data objects of a collection with a single (paged) GenQuery
+    // instead of one stat per object. Only good replicas are considered; an
+    // object without one is left out, as if it were missing. A collection that
+    // does not exist yields an empty listing.
+    inline auto list_data_objects(rcComm_t& _comm, const std::string& _collection) -> collection_listing
+    {
+        collection_listing listing;
+
+        const auto gql = "SELECT DATA_NAME, DATA_SIZE, DATA_MODIFY_TIME, DATA_CHECKSUM WHERE COLL_NAME = '" +
+                         _collection + "' AND DATA_REPL_STATUS = '1'";
+
+        for (auto&& row : irods::query<rcComm_t>{&_comm, gql}) {
+            data_object_info info;
+            info.size = std::stoull(row.at(1));
+            info.modify_time = std::stoll(row.at(2));
+            info.checksum = row.at(3);
+
+            auto [iter, inserted] = listing.try_emplace(row.at(0), info);
+
+            if (!inserted && info.modify_time > iter->second.modify_time) {
+                iter->second = std::move(info);
+            }
+        }
+
+        return listing;
+    }
+
+    // GenQuery condition on COLL_NAME that matches a collection and everything
+    // below it.
+    inline auto subtree_condition(const std::string& _collection) -> std::string
+    {
+        if (_collection == "/") {
+            return "COLL_NAME like '/%'";
+        }
+
+        return "COLL_NAME = '" + _collection + "' || like '" + _collection + "/%'";
+    }
+
+    // True if _path is _collection or lies below it. LIKE treats '_' and '%' in
+    // the collection name as wildcards, so query results must be checked.
+    inline auto within(const std::string& _path, const std::string& _collection) noexcept -> bool
+    {
+        if (_collection == "/") {
+            return !_path.empty() && _path.front() == '/';
+        }
+
+        return _path.compare(0, _collection.size(), _collection) == 0 &&
+               (_path.size() == _collection.size() || _path[_collection.size()] == '/');
+    }
+
+    // Calls _fn(collection) for a collection and every collection below it,
+    // with a single paged GenQuery. Parents come before their children.
+    template <typename Function>
+    auto for_each_collection_under(rcComm_t& _comm, const std::string& _collection, Function&& _fn) -> void
+    {
+        const auto gql = "SELECT COLL_NAME WHERE " + subtree_condition(_collection);
+
+        for (auto&& row : irods::query<rcComm_t>{&_comm, gql}) {
+            if (within(row.at(0), _collection)) {
+                _fn(row.at(0));
+            }
+        }
+    }
+
+    // Calls _fn(collection, data_name, size) for every data object in a
+    // collection and below it, with a single paged GenQuery instead of a walk
+    // that lists each collection. The size is that of a good replica, and each
+    // data object is reported once. Data objects without a good replica are
+    // passed to _no_good_replica(collection, data_name) instead.
+    template <typename Function, typename NoGoodReplica>
+    auto for_each_data_object_under(rcComm_t& _comm,
+                                    const std::string& _collection,
+                                    Function&& _fn,
+                                    NoGoodReplica&& _no_good_replica) -> void
+    {
+        const auto gql = "SELECT COLL_NAME, DATA_NAME, DATA_SIZE, DATA_REPL_STATUS WHERE " +
+                         subtree_condition(_collection);
+
+        // The replicas of a data object yield one row each per distinct size
+        // and status; the rows are sorted, so they are adjacent.
+        std::string current_collection;
+        std::string current_name;
+        std::optional<std::uint64_t> good_size;
+
+        const auto flush = [&] {
+            if (current_name.empty()) {
+                return;
+            }
+
+            const auto& collection = current_collection;
+            const auto& name = current_name;
+
+            if (good_size) {
+                _fn(collection, name, *good_size);
+            }
+            else {
+                _no_good_replica(collection, name);
+            }
+        };
+
+        for (auto&& row : irods::query<rcComm_t>{&_comm, gql}) {
+            if (!within(row.at(0), _collection)) {
+                continue;
+            }
+
+            if (row.at(0) != current_collection || row.at(1) != current_name) {
+                flush();
+                current_collection = row.at(0);
+                current_name = row.at(1);
+                good_size.reset();
+            }
+
+            if (!good_size && row.at(3) == "1") {
+                good_size = static_cast<std::uint64_t>(std::stoull(row.at(2)));
+            }
+        }
+
+        flush();
+    }
+
+    // Calls _fn(name) for every data object in a collection, with a single
+    // paged GenQuery.
+    template <typename Function>
+    auto for_each_data_object_in(rcComm_t& _comm, const std::string& _collection, Function&& _fn) -> void
+    {
+        const auto gql = "SELECT DATA_NAME WHERE COLL_NAME = '" + _collection + "'";
+
+        for (auto&& row : irods::query<rcComm_t>{&_comm, gql}) {
+            _fn(static_cast<const std::string&>(row.at(0)));
+        }
+    }
+
+    // One replica of a data object, as shown by a long listing.
+    struct replica_info
+    {
+        std::string name;
+        std::string owner;
+        std::string resource;
+        int number = 0;
+        bool good = false;
+        std::uint64_t size = 0;
+        std::int64_t modify_time = 0; // Seconds since the epoch.
+
+        // Only filled in when details are requested.
+        std::string checksum;
+        std::string physical_path;
+    };
+
+    // Calls _fn(const replica_info&) for every replica of the data objects in a
+    // collection (or of the one named _data_name), with a single paged GenQuery
+    // instead of one stat per object. The replicas of a data object are
+    // reported one after another.
+    template <typename Function>
+    auto for_each_replica_in(rcComm_t& _comm,
+                             const std::string& _collection,
+                             bool _details,
+                             Function&& _fn,
+                             const std::string& _data_name = {}) -> void
+    {
+        auto gql = std::string{"SELECT DATA_NAME, DATA_OWNER_NAME, DATA_RESC_NAME, DATA_REPL_NUM, DATA_REPL_STATUS, "
+                               "DATA_SIZE, DATA_MODIFY_TIME"};
+
+        if (_details) {
+            gql += ", DATA_CHECKSUM, DATA_PATH";
+        }
+
+        gql += " WHERE COLL_NAME = '" + _collection + "'";
+
+        if (!_data_name.empty()) {
+            gql += " AND DATA_NAME = '" + _data_name + "'";
+        }
+
+        replica_info info;
+
+        for (auto&& row : irods::query<rcComm_t>{&_comm, gql}) {
+            info.name = row.at(0);
+            info.owner = row.at(1);
+            info.resource = row.at(2);
+            info.number = std::stoi(row.at(3));
+            info.good = row.at(4) == "1";
+            info.size = std::stoull(row.at(5));
+            info.modify_time = std::stoll(row.at(6));
+
+            if (_details) {
+                info.checksum = row.at(7);
+                info.physical_path = row.at(8);
+            }
+
+            _fn(static_cast<const replica_info&>(info));
+        }
+    }
+
+    // A collection directly below another one.
+    struct subcollection_info
+    {
+        std::string path;
+        std::string owner;
+        std::int64_t modify_time = 0; // Seconds since the epoch.
+    };
+
+    // Returns the collections directly below a collection, with a single paged
+    // GenQuery.
+    inline auto list_subcollections(rcComm_t& _comm, const std::string& _collection) -> std::vector<subcollection_info>
+    {
+        std::vector<subcollection_info> subcollections;
+
+        const auto gql = "SELECT COLL_NAME, COLL_OWNER_NAME, COLL_MODIFY_TIME WHERE COLL_PARENT_NAME = '" +
+                         _collection + "'";
+
+        for (auto&& row : irods::query<rcComm_t>{&_comm, gql}) {
+            // The root collection is its own parent.
+            if (row.at(0) != _collection) {
+                subcollections.push_back({row.at(0), row.at(1), std::stoll(row.at(2))});
+            }
+        }
+
+        return subcollections;
+    }
+
+    // Calls _fn(name) for every data object in a collection and returns the
+    // paths of its subcollections. A collection that GenQuery cannot name (see
+    // queryable) is walked with the filesystem API instead, one entry at a
+    // time; that is slower, but works for any name.
+    template <typename Function>
+    auto for_each_entry_in(rcComm_t& _comm, const std::string& _collection, Function&& _fn) -> std::vector<std::string>
+    {
+        namespace fs = irods::experimental::filesystem;
+
+        std::vector<std::string> subcollections;
+
+        if (queryable(_collection)) {
+            for_each_data_object_in(_comm, _collection, _fn);
+
+            for (auto&& c : list_subcollections(_comm, _collection)) {
+                subcollections.push_back(std::move(c.path));
+            }
+
+            return subcollections;
+        }
+
+        for (auto&& e : fs::client::collection_iterator{_comm, _collection}) {
+            if (e.is_data_object()) {
+                _fn(e.path().object_name().string());
+            }
+            else {
+                subcollections.push_back(e.path().string());
+            }
+        }
+
+        return subcollections;
+    }
+
+    // Access granted on the entries of one collection, as "user#access"
+    // strings. Data objects are keyed by name and subcollections by path.
+    struct collection_acls
+    {
+        std::unordered_map<std::string, std::vector<std::string>> data_objects;
+        std::unordered_map<std::string, std::vector<std::string>> collections;
+    };
+
+    // Fetches the ACLs of everything directly in a collection with two paged
+    // GenQueries, one for the data objects and one for the subcollections,
+    // instead of one query per entry. Given _data_name, only the ACL of that
+    // data object is fetched.
+    inline auto list_acls(rcComm_t& _comm, const std::string& _collection, const std::string& _data_name = {})
+        -> collection_acls
+    {
+        collection_acls acls;
+
+        // Each replica repeats the access rows of its data object.
+        const auto add = [](std::vector<std::string>& _entries, std::string _entry) {
+            if (std::find(std::begin(_entries), std::end(_entries), _entry) == std::end(_entries)) {
+                _entries.push_back(std::move(_entry));
+            }
+        };
+
+        auto gql = "SELECT DATA_NAME, USER_NAME, DATA_ACCESS_NAME WHERE COLL_NAME = '" + _collection + "'";
+
+        if (!_data_name.empty()) {
+            gql += " AND DATA_NAME = '" + _data_name + "'";
+        }
+
+        for (auto&& row : irods::query<rcComm_t>{&_comm, gql}) {
+            add(acls.data_objects[row.at(0)], row.at(1) + '#' + row.at(2));
+        }
+
+        if (!_data_name.empty()) {
+            return acls;
+        }
+
+        gql = "SELECT COLL_NAME, COLL_USER_NAME, COLL_ACCESS_NAME WHERE COLL_PARENT_NAME = '" + _collection + "'";
+
+        for (auto&& row : irods::query<rcComm_t>{&_comm, gql}) {
+            if (row.at(0) != _collection) {
+                add(acls.collections[row.at(0)], row.at(1) + '#' + row.at(2));
+            }
+        }
+
+        return acls;
+    }
+} // namespace irods::cli
+
+#endif // IRODS_CLI_COLLECTION_LISTING_HPP
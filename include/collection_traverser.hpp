@@ -0,0 +1,422 @@
+#ifndef IRODS_CLI_COLLECTION_TRAVERSER_HPP
+#define IRODS_CLI_COLLECTION_TRAVERSER_HPP
+
+#include "byte_size.hpp"
+#include "listing_writer.hpp"
+
+#include <irods/rodsClient.h>
+#include <irods/connection_pool.hpp>
+#include <irods/thread_pool.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace irods::cli
+{
+    // True if collection _lhs comes before _rhs in a depth-first walk that
+    // visits subcollections in name order. Paths are compared component by
+    // component, i.e. as if '/' sorted before every other character.
+    inline auto walk_order(const std::string& _lhs, const std::string& _rhs) noexcept -> bool
+    {
+        return std::lexicographical_compare(
+            std::begin(_lhs), std::end(_lhs), std::begin(_rhs), std::end(_rhs), [](char _a, char _b) {
+                const auto a = _a == '/' ? 0 : static_cast<unsigned char>(_a);
+                const auto b = _b == '/' ? 0 : static_cast<unsigned char>(_b);
+                return a < b;
+            });
+    }
+
+    // The listing of one collection, as seen by the code that lists it.
+    struct collection_block
+    {
+        const std::string& collection;
+        int depth; // Zero for the collection the walk starts at.
+        listing_writer& out;
+        std::vector<std::string> subcollections;
+    };
+
+    // Walks a collection tree by listing many collections at once, each over its
+    // own connection, since a recursive listing is bound by the round trips of
+    // one query after another rather than by bandwidth.
+    //
+    // Collections waiting to be listed form a frontier that the threads take
+    // from; the subcollections a listing finds are added to it. The output of
+    // each collection is handed to the calling thread as one contiguous block,
+    // either in the order the collections were taken or, when ordered, in the
+    // order of a depth-first walk with subcollections sorted by name, so the
+    // output does not depend on timing.
+    //
+    // A block is passed on in pieces as it fills. The block that is due to be
+    // emitted streams straight through; pieces of other blocks are held until
+    // their turn, and the held bytes are capped. Past the cap, threads take no
+    // new collections and wait before handing on another piece, except:
+    //
+    //   - the thread listing the block that is due, so the output keeps moving
+    //   - in ordered mode, a thread taking the collection that is due
+    //   - one thread that is never made to wait, so that the due collection
+    //     always finds a thread; its block may take the held bytes past the cap
+    //
+    // The frontier is taken in walk order, so in ordered mode the threads list
+    // the collections closest to the one being emitted.
+    class collection_traverser
+    {
+    public:
+        collection_traverser(irods::connection_pool& _pool,
+                             int _threads,
+                             bool _ordered,
+                             std::size_t _max_held_bytes = 64 * mebibyte,
+                             std::size_t _piece_size = 64 * kibibyte)
+            : pool_{_pool}
+            , threads_{std::max(_threads, 1)}
+            , ordered_{_ordered}
+            , max_held_bytes_{_max_held_bytes}
+            , piece_size_{_piece_size}
+        {
+        }
+
+        collection_traverser(const collection_traverser&) = delete;
+        auto operator=(const collection_traverser&) -> collection_traverser& = delete;
+
+        // Walks the tree below _root. _list(rcComm_t&, collection_block&) runs
+        // on the traversal threads; it writes the listing to the block's writer
+        // and fills in its subcollections. _emit(std::string_view) runs on the
+        // calling thread and receives the output, piece by piece. A collection
+        // that cannot be listed is reported and skipped, although some of its
+        // output may already have been emitted. Returns the number of such
+        // collections.
+        template <typename List, typename Emit>
+        auto run(const std::string& _root, List&& _list, Emit&& _emit) -> int
+        {
+            frontier_.insert({_root, 0});
+
+            irods::thread_pool thread_pool{threads_};
+
+            for (int i = 0; i < threads_; ++i) {
+                irods::thread_pool::post(thread_pool, [&] { traverse(_list); });
+            }
+
+            try {
+                if (ordered_) {
+                    emit_ordered(_root, _emit);
+                }
+                else {
+                    emit_unordered(_emit);
+                }
+            }
+            catch (...) {
+                stop();
+                thread_pool.join();
+                throw;
+            }
+
+            thread_pool.join();
+
+            return failures_;
+        }
+
+    private:
+        struct pending
+        {
+            std::string collection;
+            int depth;
+        };
+
+        struct pending_order
+        {
+            auto operator()(const pending& _lhs, const pending& _rhs) const noexcept -> bool
+            {
+                return walk_order(_lhs.collection, _rhs.collection);
+            }
+        };
+
+        // A block that has been started but not yet fully emitted.
+        struct block_state
+        {
+            std::string collection;
+            int depth = 0;
+            std::deque<std::string> pieces;
+            std::vector<std::string> subcollections;
+            bool finished = false;
+        };
+
+        template <typename List>
+        auto traverse(List& _list) -> void
+        {
+            auto conn = pool_.get_connection();
+
+            for (;;) {
+                block_state* state = nullptr;
+
+                {
+                    std::unique_lock lk{mtx_};
+                    cv_.wait(lk, [this] { return stopped_ || finished() || may_take(); });
+
+                    if (stopped_ || finished()) {
+                        return;
+                    }
+
+                    auto first = std::begin(frontier_);
+                    auto owned = std::make_unique<block_state>();
+                    owned->collection = first->collection;
+                    owned->depth = first->depth;
+                    frontier_.erase(first);
+                    state = owned.get();
+
+                    if (ordered_) {
+                        auto key = state->collection;
+                        started_by_name_.emplace(std::move(key), std::move(owned));
+                    }
+                    else {
+                        started_.push_back(std::move(owned));
+                    }
+
+                    ++in_progress_;
+                }
+
+                std::vector<std::string> subcollections;
+
+                // The writer is gone before the block is marked finished, so no
+                // piece can follow.
+                {
+                    listing_writer out{[this, state](std::string_view _text) { hand_on(*state, _text); }, piece_size_};
+                    collection_block block{state->collection, state->depth, out, {}};
+
+                    try {
+                        _list(static_cast<rcComm_t&>(conn), block);
+                        out.flush();
+                        subcollections = std::move(block.subcollections);
+                    }
+                    catch (const std::exception& e) {
+                        std::cerr << "Error: " << e.what() << " [collection: " << state->collection << "]\n";
+                        out.clear();
+
+                        std::lock_guard lk{mtx_};
+                        ++failures_;
+
+                        // Whatever has not been emitted yet is dropped.
+                        for (auto&& piece : state->pieces) {
+                            held_bytes_ -= piece.size();
+                        }
+
+                        state->pieces.clear();
+                    }
+                }
+
+                std::sort(std::begin(subcollections), std::end(subcollections), walk_order);
+
+                {
+                    std::lock_guard lk{mtx_};
+
+                    for (auto&& c : subcollections) {
+                        frontier_.insert({c, state->depth + 1});
+                    }
+
+                    state->subcollections = std::move(subcollections);
+                    state->finished = true;
+                    --in_progress_;
+                }
+
+                cv_.notify_all();
+            }
+        }
+
+        // Called by a traversal thread for each full piece of a block.
+        auto hand_on(block_state& _state, std::string_view _text) -> void
+        {
+            {
+                std::unique_lock lk{mtx_};
+
+                const auto may_hand_on = [&] {
+                    return stopped_ || held_bytes_ < max_held_bytes_ || is_due(_state);
+                };
+
+                if (!may_hand_on() && waiting_ + 1 < threads_) {
+                    ++waiting_;
+                    cv_.wait(lk, may_hand_on);
+                    --waiting_;
+                }
+
+                if (stopped_) {
+                    return;
+                }
+
+                _state.pieces.emplace_back(_text);
+                held_bytes_ += _text.size();
+            }
+
+            cv_.notify_all();
+        }
+
+        template <typename Emit>
+        auto emit_ordered(const std::string& _root, Emit& _emit) -> void
+        {
+            std::vector<std::string> stack{_root};
+
+            while (!stack.empty()) {
+                std::unique_lock lk{mtx_};
+                next_ = stack.back();
+                stack.pop_back();
+                cv_.notify_all();
+
+                for (;;) {
+                    cv_.wait(lk, [this] {
+                        if (stopped_) {
+                            return true;
+                        }
+
+                        const auto iter = started_by_name_.find(next_);
+                        return iter != std::end(started_by_name_) && (!iter->second->pieces.empty() || iter->second->finished);
+                    });
+
+                    if (stopped_) {
+                        return;
+                    }
+
+                    const auto iter = started_by_name_.find(next_);
+                    auto& state = *iter->second;
+                    const auto done = state.finished;
+                    auto pieces = take_pieces(state);
+                    std::vector<std::string> subcollections;
+
+                    if (done) {
+                        subcollections = std::move(state.subcollections);
+                        started_by_name_.erase(iter);
+                    }
+
+                    lk.unlock();
+                    cv_.notify_all();
+
+                    for (auto&& piece : pieces) {
+                        _emit(std::string_view{piece});
+                    }
+
+                    if (done) {
+                        // The first subcollection must be on top.
+                        stack.insert(std::end(stack), std::rbegin(subcollections), std::rend(subcollections));
+                        break;
+                    }
+
+                    lk.lock();
+                }
+            }
+        }
+
+        template <typename Emit>
+        auto emit_unordered(Emit& _emit) -> void
+        {
+            for (;;) {
+                std::deque<std::string> pieces;
+
+                {
+                    std::unique_lock lk{mtx_};
+                    cv_.wait(lk, [this] {
+                        return stopped_ || (started_.empty() && finished()) ||
+                               (!started_.empty() && (!started_.front()->pieces.empty() || started_.front()->finished));
+                    });
+
+                    if (stopped_ || started_.empty()) {
+                        return;
+                    }
+
+                    auto& state = *started_.front();
+                    const auto done = state.finished;
+                    pieces = take_pieces(state);
+
+                    // The next block becomes due.
+                    if (done) {
+                        started_.pop_front();
+                    }
+                }
+
+                cv_.notify_all();
+
+                for (auto&& piece : pieces) {
+                    _emit(std::string_view{piece});
+                }
+            }
+        }
+
+        // Expects the mutex to be held.
+        auto take_pieces(block_state& _state) -> std::deque<std::string>
+        {
+            std::deque<std::string> pieces;
+            pieces.swap(_state.pieces);
+
+            for (auto&& piece : pieces) {
+                held_bytes_ -= piece.size();
+            }
+
+            return pieces;
+        }
+
+        // Expects the mutex to be held.
+        auto is_due(const block_state& _state) const -> bool
+        {
+            if (ordered_) {
+                return _state.collection == next_;
+            }
+
+            return !started_.empty() && started_.front().get() == &_state;
+        }
+
+        // Expects the mutex to be held.
+        auto finished() const noexcept -> bool
+        {
+            return frontier_.empty() && in_progress_ == 0;
+        }
+
+        // Expects the mutex to be held.
+        auto may_take() const -> bool
+        {
+            if (frontier_.empty()) {
+                return false;
+            }
+
+            return held_bytes_ < max_held_bytes_ || (ordered_ && std::begin(frontier_)->collection == next_);
+        }
+
+        auto stop() -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                stopped_ = true;
+            }
+
+            cv_.notify_all();
+        }
+
+        irods::connection_pool& pool_;
+        const int threads_;
+        const bool ordered_;
+        const std::size_t max_held_bytes_;
+        const std::size_t piece_size_;
+
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        std::set<pending, pending_order> frontier_;
+        int in_progress_ = 0;
+        int waiting_ = 0; // Threads waiting in hand_on().
+        std::size_t held_bytes_ = 0;
+        int failures_ = 0;
+        bool stopped_ = false;
+
+        // Blocks that have been started but not yet fully emitted.
+        std::map<std::string, std::unique_ptr<block_state>> started_by_name_; // Ordered mode.
+        std::deque<std::unique_ptr<block_state>> started_;                    // Unordered mode, in the order taken.
+        std::string next_;                                                    // The block due in ordered mode.
+    }; // class collection_traverser
+} // namespace irods::cli
+
+#endif // IRODS_CLI_COLLECTION_TRAVERSER_HPP
@@ -0,0 +1,278 @@
+#ifndef IRODS_CLI_LISTING_FORMAT_HPP
+#define IRODS_CLI_LISTING_FORMAT_HPP
+
+#include "listing_writer.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace irods::cli
+{
+    // How listing commands print their entries. Everything but text is meant
+    // for other programs and is written one entry at a time, so a listing of
+    // any size streams in constant memory.
+    //
+    //   text  : the human-readable layout of each command
+    //   jsonl : one JSON object per line, with only the fields that apply to the entry;
+    //           ill-formed UTF-8 is replaced by U+FFFD
+    //   tsv   : tab-separated fields in a fixed order; tabs, newlines, carriage
+    //           returns and backslashes are escaped as \t, \n, \r and \\, and fields
+    //           that do not apply are empty
+    //   nul   : the logical path followed by a NUL byte, e.g. for xargs -0
+    enum class listing_format
+    {
+        text,
+        jsonl,
+        nul,
+        tsv
+    };
+
+    inline auto parse_listing_format(std::string_view _name) noexcept -> std::optional<listing_format>
+    {
+        if (_name == "text") {
+            return listing_format::text;
+        }
+
+        if (_name == "jsonl") {
+            return listing_format::jsonl;
+        }
+
+        if (_name == "nul") {
+            return listing_format::nul;
+        }
+
+        if (_name == "tsv") {
+            return listing_format::tsv;
+        }
+
+        return std::nullopt;
+    }
+
+    // The groups of fields a listing carries. Every row of a tsv listing has
+    // the columns of the enabled groups, in this order:
+    //
+    //   type, path
+    //   owner, replica, resource, size, modify_time, good (replicas)
+    //   checksum, physical_path                           (details)
+    //   acl, as comma-separated user#access entries       (acls)
+    struct listing_columns
+    {
+        bool replicas = false;
+        bool details = false;
+        bool acls = false;
+    };
+
+    // One entry of a listing. Views must stay valid until the row is written.
+    struct listing_row
+    {
+        std::string_view type; // "data_object" or "collection".
+        std::string_view path;
+        std::optional<std::string_view> owner;
+        std::optional<int> replica;
+        std::optional<std::string_view> resource;
+        std::optional<std::uint64_t> size;
+        std::optional<std::int64_t> modify_time; // Seconds since the epoch.
+        std::optional<bool> good;
+        std::optional<std::string_view> checksum;
+        std::optional<std::string_view> physical_path;
+        const std::vector<std::string>* acls = nullptr;
+    };
+
+    namespace detail
+    {
+        // iRODS names are arbitrary bytes, but JSON text must be UTF-8, so
+        // ill-formed sequences become U+FFFD.
+        inline auto write_json_string(listing_writer& _out, std::string_view _text) -> void
+        {
+            _out.write(nlohmann::json(std::string{_text}).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace));
+        }
+
+        inline auto write_tsv_field(listing_writer& _out, std::string_view _text) -> void
+        {
+            std::size_t start = 0;
+
+            for (std::size_t i = 0; i < _text.size(); ++i) {
+                const auto c = _text[i];
+
+                if (c != '\t' && c != '\n' && c != '\r' && c != '\\') {
+                    continue;
+                }
+
+                _out.write(_text.substr(start, i - start));
+                start = i + 1;
+
+                switch (c) {
+                    case '\t': _out.write("\\t"); break;
+                    case '\n': _out.write("\\n"); break;
+                    case '\r': _out.write("\\r"); break;
+                    default:   _out.write("\\\\"); break;
+                }
+            }
+
+            _out.write(_text.substr(start));
+        }
+
+        inline auto write_jsonl(listing_writer& _out, const listing_columns& _columns, const listing_row& _row) -> void
+        {
+            const auto string_field = [&_out](std::string_view _name, const std::optional<std::string_view>& _value) {
+                if (_value) {
+                    _out.print(",\"{}\":", _name);
+                    write_json_string(_out, *_value);
+                }
+            };
+
+            _out.write("{\"type\":");
+            write_json_string(_out, _row.type);
+            _out.write(",\"path\":");
+            write_json_string(_out, _row.path);
+            string_field("owner", _row.owner);
+
+            if (_row.replica) {
+                _out.print(",\"replica\":{}", *_row.replica);
+            }
+
+            string_field("resource", _row.resource);
+
+            if (_row.size) {
+                _out.print(",\"size\":{}", *_row.size);
+            }
+
+            if (_row.modify_time) {
+                _out.print(",\"modify_time\":{}", *_row.modify_time);
+            }
+
+            if (_row.good) {
+                _out.write(*_row.good ? ",\"good\":true" : ",\"good\":false");
+            }
+
+            string_field("checksum", _row.checksum);
+            string_field("physical_path", _row.physical_path);
+
+            if (_columns.acls) {
+                _out.write(",\"acl\":[");
+
+                if (_row.acls) {
+                    for (std::size_t i = 0; i < _row.acls->size(); ++i) {
+                        if (i > 0) {
+                            _out.write(",");
+                        }
+
+                        write_json_string(_out, (*_row.acls)[i]);
+                    }
+                }
+
+                _out.write("]");
+            }
+
+            _out.write("}\n");
+        }
+
+        inline auto write_tsv(listing_writer& _out, const listing_columns& _columns, const listing_row& _row) -> void
+        {
+            const auto string_field = [&_out](const std::optional<std::string_view>& _value) {
+                _out.write("\t");
+
+                if (_value) {
+                    write_tsv_field(_out, *_value);
+                }
+            };
+
+            write_tsv_field(_out, _row.type);
+            _out.write("\t");
+            write_tsv_field(_out, _row.path);
+
+            if (_columns.replicas) {
+                string_field(_row.owner);
+                _out.write("\t");
+
+                if (_row.replica) {
+                    _out.print("{}", *_row.replica);
+                }
+
+                string_field(_row.resource);
+                _out.write("\t");
+
+                if (_row.size) {
+                    _out.print("{}", *_row.size);
+                }
+
+                _out.write("\t");
+
+                if (_row.modify_time) {
+                    _out.print("{}", *_row.modify_time);
+                }
+
+                _out.write("\t");
+
+                if (_row.good) {
+                    _out.write(*_row.good ? "1" : "0");
+                }
+            }
+
+            if (_columns.details) {
+                string_field(_row.checksum);
+                string_field(_row.physical_path);
+            }
+
+            if (_columns.acls) {
+                _out.write("\t");
+
+                if (_row.acls) {
+                    for (std::size_t i = 0; i < _row.acls->size(); ++i) {
+                        if (i > 0) {
+                            _out.write(",");
+                        }
+
+                        write_tsv_field(_out, (*_row.acls)[i]);
+                    }
+                }
+            }
+
+            _out.write("\n");
+        }
+    } // namespace detail
+
+    // Writes a row in one of the machine-readable formats.
+    inline auto write_row(listing_writer& _out,
+                          listing_format _format,
+                          const listing_columns& _columns,
+                          const listing_row& _row) -> void
+    {
+        switch (_format) {
+            case listing_format::jsonl:
+                detail::write_jsonl(_out, _columns, _row);
+                break;
+
+            case listing_format::tsv:
+                detail::write_tsv(_out, _columns, _row);
+                break;
+
+            case listing_format::nul:
+                _out.write(_row.path);
+                _out.write({"", 1});
+                break;
+
+            case listing_format::text:
+                break;
+        }
+    }
+
+    // Sets _path to the logical path of _name in _collection, reusing its storage.
+    inline auto join_logical_path(std::string& _path, std::string_view _collection, std::string_view _name) -> void
+    {
+        _path.assign(_collection.data(), _collection.size());
+
+        if (_path.empty() || _path.back() != '/') {
+            _path += '/';
+        }
+
+        _path.append(_name.data(), _name.size());
+    }
+} // namespace irods::cli
+
+#endif // IRODS_CLI_LISTING_FORMAT_HPP
@@ -0,0 +1,181 @@
+#ifndef IRODS_CLI_LISTING_WRITER_HPP
+#define IRODS_CLI_LISTING_WRITER_HPP
+
+#include <fmt/format.h>
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace irods::cli
+{
+    // Formats listing rows into one reusable buffer and writes it out in large
+    // blocks, so that a listing of millions of rows costs a few thousand
+    // system calls instead of one or more per row. Nothing is allocated per row
+    // once the buffer has grown to its working size.
+    //
+    // Anything still buffered is written when the writer is destroyed; call
+    // flush() first to see write errors. A writer without a file descriptor
+    // (-1) only collects text. A writer with a sink hands each full block to
+    // it instead, e.g. to pass a listing put together on another thread to
+    // the one that writes it out.
+    class listing_writer
+    {
+    public:
+        using sink_type = std::function<void(std::string_view)>;
+
+        explicit listing_writer(int _fd = STDOUT_FILENO, std::size_t _block_size = 256 * 1024)
+            : fd_{_fd}
+            , block_size_{_block_size}
+        {
+            buffer_.reserve(block_size_ + 4096);
+        }
+
+        listing_writer(sink_type _sink, std::size_t _block_size)
+            : fd_{-1}
+            , block_size_{_block_size}
+            , sink_{std::move(_sink)}
+        {
+            buffer_.reserve(block_size_ + 4096);
+        }
+
+        listing_writer(const listing_writer&) = delete;
+        auto operator=(const listing_writer&) -> listing_writer& = delete;
+
+        ~listing_writer()
+        {
+            try {
+                flush();
+            }
+            catch (...) {
+            }
+        }
+
+        template <typename... Args>
+        auto print(fmt::format_string<Args...> _format, Args&&... _args) -> void
+        {
+            fmt::format_to(std::back_inserter(buffer_), _format, std::forward<Args>(_args)...);
+            flush_if_full();
+        }
+
+        auto write(std::string_view _text) -> void
+        {
+            buffer_.append(_text.data(), _text.data() + _text.size());
+            flush_if_full();
+        }
+
+        // Appends _count copies of _c, e.g. for indentation.
+        auto fill(char _c, std::size_t _count) -> void
+        {
+            const auto size = buffer_.size();
+            buffer_.resize(size + _count);
+            std::memset(buffer_.data() + size, _c, _count);
+            flush_if_full();
+        }
+
+        // The collected text of a writer without a file descriptor.
+        auto text() const noexcept -> std::string_view
+        {
+            return {buffer_.data(), buffer_.size()};
+        }
+
+        auto clear() noexcept -> void
+        {
+            buffer_.clear();
+        }
+
+        // Formats a time as "YYYY-MM-DD HH:MM:SS" in the local time zone. The
+        // result is valid until the next call.
+        //
+        // Converting to local time is far more expensive than the rest of a
+        // row, so the formatted minute is cached and only the seconds are
+        // filled in while times stay within it. Time zone changes happen on
+        // minute boundaries, so the cache is exact.
+        auto timestamp(std::int64_t _seconds) -> std::string_view
+        {
+            if (_seconds < minute_start_ || _seconds >= minute_start_ + 60) {
+                const auto t = static_cast<std::time_t>(_seconds);
+                std::tm tm{};
+
+                if (!::localtime_r(&t, &tm) || std::strftime(timestamp_, sizeof(timestamp_), "%F %T", &tm) == 0) {
+                    return "0000-00-00 00:00:00";
+                }
+
+                timestamp_size_ = std::strlen(timestamp_);
+                minute_start_ = _seconds - tm.tm_sec;
+            }
+
+            const auto second = static_cast<int>(_seconds - minute_start_);
+            timestamp_[timestamp_size_ - 2] = static_cast<char>('0' + second / 10);
+            timestamp_[timestamp_size_ - 1] = static_cast<char>('0' + second % 10);
+
+            return {timestamp_, timestamp_size_};
+        }
+
+        auto flush() -> void
+        {
+            if (sink_) {
+                if (buffer_.size() > 0) {
+                    sink_({buffer_.data(), buffer_.size()});
+                    buffer_.clear();
+                }
+
+                return;
+            }
+
+            if (fd_ < 0) {
+                return;
+            }
+
+            const char* data = buffer_.data();
+            auto size = buffer_.size();
+
+            while (size > 0) {
+                const auto n = ::write(fd_, data, size);
+
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    buffer_.clear();
+                    throw std::runtime_error{std::string{"Cannot write listing [error: "} + std::strerror(errno) + "]."};
+                }
+
+                data += n;
+                size -= static_cast<std::size_t>(n);
+            }
+
+            buffer_.clear();
+        }
+
+    private:
+        auto flush_if_full() -> void
+        {
+            if ((fd_ >= 0 || sink_) && buffer_.size() >= block_size_) {
+                flush();
+            }
+        }
+
+        const int fd_;
+        const std::size_t block_size_;
+        const sink_type sink_;
+        fmt::memory_buffer buffer_;
+
+        std::int64_t minute_start_ = INT64_MIN / 2;
+        char timestamp_[64] = {};
+        std::size_t timestamp_size_ = 0;
+    }; // class listing_writer
+} // namespace irods::cli
+
+#endif // IRODS_CLI_LISTING_WRITER_HPP
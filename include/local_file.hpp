@@ -0,0 +1,221 @@
+#ifndef IRODS_CLI_LOCAL_FILE_HPP
+#define IRODS_CLI_LOCAL_FILE_HPP
+
+#include "buffer_pool.hpp"
+#include "async_io.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace irods::cli
+{
+    enum class read_mode
+    {
+        pread,
+        mmap
+    };
+
+    struct read_options
+    {
+        read_mode mode = read_mode::pread;
+
+        // Bypass the page cache with O_DIRECT (pread mode only).
+        bool direct_io = false;
+
+        // Drop pages from the page cache once they have been sent.
+        bool drop_cache = false;
+    };
+
+    // A local file opened for uploading.
+    //
+    // read_range() hands the requested bytes to a sink without an iostream in
+    // between. In pread mode they are read through the caller's async_reader,
+    // which keeps several block reads in flight ahead of the sink; in mmap mode
+    // the sink receives pointers straight into the mapping, so no user-space
+    // copy is made at all. The file is read sequentially by each caller, which
+    // is what the kernel is told through fadvise/madvise.
+    class local_file
+    {
+    public:
+        local_file(const std::string& _path, const read_options& _options)
+            : path_{_path}
+            , options_{_options}
+        {
+            int flags = O_RDONLY | O_CLOEXEC;
+
+            if (options_.direct_io && options_.mode == read_mode::pread) {
+                flags |= O_DIRECT;
+            }
+
+            fd_ = ::open(path_.c_str(), flags);
+
+            if (fd_ < 0) {
+                throw std::runtime_error{"Cannot open file for reading [path: " + path_ + ", error: " +
+                                         std::strerror(errno) + "]."};
+            }
+
+            struct stat st;
+
+            if (::fstat(fd_, &st) != 0) {
+                const auto ec = errno;
+                ::close(fd_);
+                throw std::runtime_error{"Cannot stat file [path: " + path_ + ", error: " + std::strerror(ec) + "]."};
+            }
+
+            size_ = static_cast<std::uint64_t>(st.st_size);
+
+            ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+            if (options_.mode == read_mode::mmap && size_ > 0) {
+                map_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+
+                if (map_ == MAP_FAILED) {
+                    const auto ec = errno;
+                    ::close(fd_);
+                    throw std::runtime_error{"Cannot map file [path: " + path_ + ", error: " + std::strerror(ec) + "]."};
+                }
+
+                ::madvise(map_, size_, MADV_SEQUENTIAL);
+            }
+        }
+
+        local_file(const local_file&) = delete;
+        auto operator=(const local_file&) -> local_file& = delete;
+
+        ~local_file()
+        {
+            if (map_ != MAP_FAILED) {
+                ::munmap(map_, size_);
+            }
+
+            ::close(fd_);
+        }
+
+        auto size() const noexcept -> std::uint64_t
+        {
+            return size_;
+        }
+
+        auto native_handle() const noexcept -> int
+        {
+            return fd_;
+        }
+
+        auto mapped() const noexcept -> bool
+        {
+            return map_ != MAP_FAILED;
+        }
+
+        // Calls _sink(const char*, std::size_t) for consecutive pieces of
+        // [_offset, _offset + _length). Throws if the file is shorter than that.
+        template <typename Sink>
+        auto read_range(std::uint64_t _offset, std::uint64_t _length, async_reader& _reader, Sink&& _sink) -> void
+        {
+            if (_offset + _length > size_) {
+                throw std::runtime_error{"Short read [path: " + path_ + "]."};
+            }
+
+            if (map_ != MAP_FAILED) {
+                const auto* base = static_cast<const char*>(map_);
+
+                for (auto pos = _offset, end = _offset + _length; pos < end;) {
+                    const auto n = std::min<std::uint64_t>(_reader.block_size(), end - pos);
+                    _sink(base + pos, static_cast<std::size_t>(n));
+                    pos += n;
+                }
+            }
+            else {
+                auto next = _offset;
+                auto pos = _offset;
+                const auto end = _offset + _length;
+
+                _reader.run(
+                    [&]() -> std::optional<read_extent> {
+                        if (next >= end) {
+                            return std::nullopt;
+                        }
+
+                        const auto e = extent_at(next, end, _reader.block_size());
+                        next = e.offset + std::min<std::uint64_t>(e.length, end - e.offset);
+                        return e;
+                    },
+                    [&](const read_extent& _e, const char* _data, std::size_t _size, int _error) {
+                        const auto n = usable_bytes(_e, _size, _error, pos, end);
+                        _sink(_data + (pos - _e.offset), n);
+                        pos += n;
+                    });
+            }
+
+            if (options_.drop_cache) {
+                drop_cache(_offset, _length);
+            }
+        }
+
+        // Returns the read that continues the range at _pos. O_DIRECT needs
+        // aligned offsets and lengths, so the read starts at the aligned offset
+        // below _pos and its length is rounded up; usable_bytes() accounts for
+        // the difference. The next read of the range starts where this one's
+        // useful part ends.
+        auto extent_at(std::uint64_t _pos, std::uint64_t _end, std::size_t _block_size, std::uint64_t _tag = 0) const
+            -> read_extent
+        {
+            const std::uint64_t align = options_.direct_io ? aligned_buffer::alignment : 1;
+            const auto aligned_pos = _pos / align * align;
+            const auto wanted = std::min<std::uint64_t>(_block_size, _end - aligned_pos);
+            const auto request = std::min<std::uint64_t>((wanted + align - 1) / align * align, _block_size);
+
+            return {fd_, aligned_pos, static_cast<std::size_t>(request), _tag};
+        }
+
+        // Returns how many bytes of a completed read of extent_at(_pos, _end)
+        // belong to the range, starting at _pos. Throws if the read failed.
+        auto usable_bytes(const read_extent& _e,
+                          std::size_t _size,
+                          int _error,
+                          std::uint64_t _pos,
+                          std::uint64_t _end) const -> std::size_t
+        {
+            if (_error != 0) {
+                throw std::runtime_error{"Read failed [path: " + path_ + ", error: " + std::strerror(_error) + "]."};
+            }
+
+            const auto wanted = std::min<std::uint64_t>(_e.length, _end - _e.offset);
+
+            if (_size < wanted || _pos < _e.offset) {
+                throw std::runtime_error{"Short read [path: " + path_ + "]."};
+            }
+
+            return static_cast<std::size_t>(wanted - (_pos - _e.offset));
+        }
+
+        auto drop_cache(std::uint64_t _offset, std::uint64_t _length) -> void
+        {
+            if (map_ != MAP_FAILED) {
+                const auto page = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+                const auto start = _offset / page * page;
+                ::madvise(static_cast<char*>(map_) + start, _offset + _length - start, MADV_DONTNEED);
+            }
+
+            ::posix_fadvise(fd_, static_cast<off_t>(_offset), static_cast<off_t>(_length), POSIX_FADV_DONTNEED);
+        }
+
+    private:
+        const std::string path_;
+        const read_options options_;
+        int fd_ = -1;
+        std::uint64_t size_ = 0;
+        void* map_ = MAP_FAILED;
+    }; // class local_file
+} // namespace irods::cli
+
+#endif // IRODS_CLI_LOCAL_FILE_HPP
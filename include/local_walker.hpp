@@ -0,0 +1,313 @@
+#ifndef IRODS_CLI_LOCAL_WALKER_HPP
+#define IRODS_CLI_LOCAL_WALKER_HPP
+
+#include <irods/thread_pool.hpp>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace irods::cli
+{
+    // Enumerates a local directory tree using getdents64(2) directly.
+    //
+    // The type of each entry is taken from d_type, so the common case needs no
+    // stat(2) at all. Only entries whose type the file system does not report
+    // (DT_UNKNOWN) and symbolic links (which are followed, like
+    // boost::filesystem::status()) are stat'ed. Subdirectories are pushed onto a
+    // shared stack and scanned by several threads at once. They are pushed
+    // after every getdents64(2) batch, and progress is reported as often, so a
+    // huge directory neither keeps the other threads idle nor the counters still
+    // until it has been read to the end.
+    //
+    // Paths handed to the callbacks are relative to the root; the root itself is
+    // reported as an empty path. A directory is always reported before any of
+    // its entries. Callbacks are invoked concurrently from the walker threads.
+    class local_walker
+    {
+    public:
+        struct stats
+        {
+            std::uint64_t directories;
+            std::uint64_t files;
+            std::uint64_t others;
+            std::uint64_t stat_calls;
+            double elapsed_seconds;
+
+            auto entries_per_second() const noexcept -> double
+            {
+                const auto entries = directories + files + others;
+                return elapsed_seconds > 0 ? static_cast<double>(entries) / elapsed_seconds : 0.0;
+            }
+        };
+
+        struct callbacks
+        {
+            std::function<void(const std::string&)> on_directory;
+            std::function<void(const std::string&)> on_file;
+            std::function<void(const std::string&, int)> on_error;
+
+            // Optional. Invoked from a walker thread at most once per progress interval.
+            std::function<void(const stats&)> on_progress;
+
+            // Optional. Invoked once all entries of a directory have been reported,
+            // from the thread that reported them.
+            std::function<void(const std::string&)> on_directory_done;
+        };
+
+        local_walker(std::string _root,
+                     int _threads,
+                     std::chrono::steady_clock::duration _progress_interval = std::chrono::seconds{5})
+            : root_{std::move(_root)}
+            , threads_{std::max(_threads, 1)}
+            , progress_interval_{_progress_interval}
+        {
+        }
+
+        local_walker(const local_walker&) = delete;
+        auto operator=(const local_walker&) -> local_walker& = delete;
+
+        // Walks the whole tree and returns once every directory has been scanned.
+        auto walk(const callbacks& _callbacks) -> void
+        {
+            start_ = std::chrono::steady_clock::now();
+            next_progress_ = (start_ + progress_interval_).time_since_epoch().count();
+
+            _callbacks.on_directory("");
+            ++directories_;
+            pending_.push_back("");
+            outstanding_ = 1;
+
+            irods::thread_pool pool{threads_};
+
+            for (int i = 0; i < threads_; ++i) {
+                irods::thread_pool::post(pool, [this, &_callbacks] { run(_callbacks); });
+            }
+
+            pool.join();
+
+            finish_ = std::chrono::steady_clock::now();
+            done_ = true;
+        }
+
+        // May be called while the walk is in progress.
+        auto current_stats() const -> stats
+        {
+            const auto end = done_ ? finish_ : std::chrono::steady_clock::now();
+
+            return {directories_.load(),
+                    files_.load(),
+                    others_.load(),
+                    stat_calls_.load(),
+                    std::chrono::duration<double>(end - start_).count()};
+        }
+
+    private:
+        // Layout of the records returned by getdents64(2).
+        struct linux_dirent64
+        {
+            ino64_t d_ino;
+            off64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[1];
+        };
+
+        auto run(const callbacks& _callbacks) -> void
+        {
+            std::vector<char> buffer(256 * 1024);
+
+            for (;;) {
+                std::string dir;
+
+                {
+                    std::unique_lock lk{mtx_};
+                    cv_.wait(lk, [this] { return !pending_.empty() || outstanding_ == 0; });
+
+                    if (pending_.empty()) {
+                        return;
+                    }
+
+                    // Depth-first keeps the stack small on wide trees.
+                    dir = std::move(pending_.back());
+                    pending_.pop_back();
+                }
+
+                scan(dir, buffer, _callbacks);
+
+                {
+                    std::lock_guard lk{mtx_};
+
+                    if (--outstanding_ == 0) {
+                        cv_.notify_all();
+                    }
+                }
+            }
+        }
+
+        auto scan(const std::string& _dir, std::vector<char>& _buffer, const callbacks& _callbacks) -> void
+        {
+            const auto abs_dir = _dir.empty() ? root_ : root_ + '/' + _dir;
+            const int fd = ::open(abs_dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+            if (fd < 0) {
+                _callbacks.on_error(abs_dir, errno);
+                return;
+            }
+
+            std::vector<std::string> subdirs;
+
+            for (;;) {
+                const auto n = ::syscall(SYS_getdents64, fd, _buffer.data(), _buffer.size());
+
+                if (n < 0) {
+                    _callbacks.on_error(abs_dir, errno);
+                    break;
+                }
+
+                if (n == 0) {
+                    break;
+                }
+
+                for (long pos = 0; pos < n;) {
+                    const auto* d = reinterpret_cast<const linux_dirent64*>(_buffer.data() + pos);
+                    pos += d->d_reclen;
+
+                    const std::string_view name = d->d_name;
+
+                    if (name == "." || name == "..") {
+                        continue;
+                    }
+
+                    auto rel = _dir.empty() ? std::string{name} : _dir + '/' + std::string{name};
+
+                    switch (resolve_type(fd, d)) {
+                        case DT_REG:
+                            ++files_;
+                            _callbacks.on_file(rel);
+                            break;
+
+                        case DT_DIR:
+                            ++directories_;
+                            _callbacks.on_directory(rel);
+                            subdirs.push_back(std::move(rel));
+                            break;
+
+                        default:
+                            ++others_;
+                            break;
+                    }
+                }
+
+                push_pending(subdirs);
+                maybe_report_progress(_callbacks);
+            }
+
+            ::close(fd);
+
+            if (_callbacks.on_directory_done) {
+                _callbacks.on_directory_done(_dir);
+            }
+        }
+
+        // Hands the subdirectories found so far to the other threads.
+        auto push_pending(std::vector<std::string>& _subdirs) -> void
+        {
+            if (_subdirs.empty()) {
+                return;
+            }
+
+            {
+                std::lock_guard lk{mtx_};
+                outstanding_ += _subdirs.size();
+
+                for (auto&& s : _subdirs) {
+                    pending_.push_back(std::move(s));
+                }
+            }
+
+            _subdirs.clear();
+            cv_.notify_all();
+        }
+
+        auto maybe_report_progress(const callbacks& _callbacks) -> void
+        {
+            if (!_callbacks.on_progress) {
+                return;
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            auto due = next_progress_.load(std::memory_order_relaxed);
+
+            // Only the thread that moves the deadline forward reports.
+            if (now.time_since_epoch().count() < due ||
+                !next_progress_.compare_exchange_strong(due, (now + progress_interval_).time_since_epoch().count()))
+            {
+                return;
+            }
+
+            _callbacks.on_progress(current_stats());
+        }
+
+        auto resolve_type(int _dir_fd, const linux_dirent64* _d) -> unsigned char
+        {
+            if (_d->d_type != DT_UNKNOWN && _d->d_type != DT_LNK) {
+                return _d->d_type;
+            }
+
+            ++stat_calls_;
+
+            struct stat st;
+
+            if (::fstatat(_dir_fd, _d->d_name, &st, 0) != 0) {
+                return DT_UNKNOWN;
+            }
+
+            if (S_ISREG(st.st_mode)) {
+                return DT_REG;
+            }
+
+            if (S_ISDIR(st.st_mode)) {
+                return DT_DIR;
+            }
+
+            return DT_UNKNOWN;
+        }
+
+        const std::string root_;
+        const int threads_;
+        const std::chrono::steady_clock::duration progress_interval_;
+
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        std::vector<std::string> pending_;
+        std::size_t outstanding_ = 0;
+
+        std::atomic<std::uint64_t> directories_{0};
+        std::atomic<std::uint64_t> files_{0};
+        std::atomic<std::uint64_t> others_{0};
+        std::atomic<std::uint64_t> stat_calls_{0};
+
+        std::chrono::steady_clock::time_point start_{};
+        std::chrono::steady_clock::time_point finish_{};
+        std::atomic<std::chrono::steady_clock::rep> next_progress_{0};
+        std::atomic<bool> done_{false};
+    }; // class local_walker
+} // namespace irods::cli
+
+#endif // IRODS_CLI_LOCAL_WALKER_HPP
@@ -0,0 +1,104 @@
+#ifndef IRODS_CLI_MANIFEST_READER_HPP
+#define IRODS_CLI_MANIFEST_READER_HPP
+
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace irods::cli
+{
+    // One transfer listed in a manifest. The destination is empty if the record
+    // names only the source.
+    struct manifest_entry
+    {
+        std::string source;
+        std::string destination;
+        std::uint64_t record = 0; // Counting from one, for messages.
+    };
+
+    // Reads a manifest of transfers one record at a time, so that a list of
+    // millions of files is never held in memory.
+    //
+    // Records end with a newline, or with a NUL byte for lists produced by tools
+    // such as "find -print0", which allows newlines in names. A record holds the
+    // source path, optionally followed by a tab and the destination. Empty
+    // records are skipped, as is the carriage return of a CRLF line ending.
+    class manifest_reader
+    {
+    public:
+        manifest_reader(std::FILE* _in, char _delimiter)
+            : in_{_in}
+            , delimiter_{_delimiter}
+        {
+        }
+
+        manifest_reader(const manifest_reader&) = delete;
+        auto operator=(const manifest_reader&) -> manifest_reader& = delete;
+
+        ~manifest_reader()
+        {
+            std::free(buffer_);
+        }
+
+        auto next() -> std::optional<manifest_entry>
+        {
+            for (;;) {
+                errno = 0;
+                auto length = ::getdelim(&buffer_, &capacity_, delimiter_, in_);
+
+                if (length < 0) {
+                    if (std::ferror(in_)) {
+                        throw std::runtime_error{std::string{"Cannot read manifest [error: "} + std::strerror(errno) +
+                                                 "]."};
+                    }
+
+                    return std::nullopt;
+                }
+
+                ++records_;
+
+                if (length > 0 && buffer_[length - 1] == delimiter_) {
+                    --length;
+                }
+
+                if (delimiter_ == '\n' && length > 0 && buffer_[length - 1] == '\r') {
+                    --length;
+                }
+
+                if (length == 0) {
+                    continue;
+                }
+
+                const std::string record(buffer_, static_cast<std::size_t>(length));
+                manifest_entry entry;
+                entry.record = records_;
+
+                if (const auto tab = record.find('\t'); tab != std::string::npos) {
+                    entry.source = record.substr(0, tab);
+                    entry.destination = record.substr(tab + 1);
+                }
+                else {
+                    entry.source = record;
+                }
+
+                return entry;
+            }
+        }
+
+    private:
+        std::FILE* in_;
+        const char delimiter_;
+        char* buffer_ = nullptr;
+        std::size_t capacity_ = 0;
+        std::uint64_t records_ = 0;
+    }; // class manifest_reader
+} // namespace irods::cli
+
+#endif // IRODS_CLI_MANIFEST_READER_HPP
@@ -0,0 +1,125 @@
+#ifndef IRODS_CLI_RANGE_WINDOW_HPP
+#define IRODS_CLI_RANGE_WINDOW_HPP
+
+#include "buffer_pool.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace irods::cli
+{
+    // Puts ranges that are fetched in parallel back into stream order.
+    //
+    // The window holds one buffer per range that may be in flight. Range i goes
+    // to buffer i % count, and a fetcher may only start on it once range
+    // i - count has been consumed. The fetchers can therefore run at most count
+    // ranges ahead of the consumer, and memory never exceeds count * range size.
+    // A fetcher never waits on a range that is ahead of its own, so claiming
+    // ranges in ascending order (see chunk_scheduler) cannot deadlock.
+    class range_window
+    {
+    public:
+        struct slot
+        {
+            explicit slot(aligned_buffer _buffer)
+                : buffer{std::move(_buffer)}
+            {
+            }
+
+            aligned_buffer buffer;
+            std::size_t size = 0;
+            bool filled = false;
+        };
+
+        range_window(std::size_t _count, std::size_t _range_size, std::uint64_t _range_count)
+            : range_count_{_range_count}
+        {
+            const auto count = std::max<std::size_t>(_count, 1);
+            slots_.reserve(count);
+
+            for (auto&& buffer : buffer_pool::instance().acquire(count, _range_size)) {
+                slots_.push_back(std::make_unique<slot>(std::move(buffer)));
+            }
+        }
+
+        range_window(const range_window&) = delete;
+        auto operator=(const range_window&) -> range_window& = delete;
+
+        // Fetcher side. Blocks until the buffer for range _index is free.
+        // Returns nullptr once the window has been cancelled.
+        auto acquire(std::uint64_t _index) -> slot*
+        {
+            std::unique_lock lk{mtx_};
+            cv_.wait(lk, [&] { return cancelled_ || _index < consumed_ + slots_.size(); });
+
+            return cancelled_ ? nullptr : slots_[_index % slots_.size()].get();
+        }
+
+        // Fetcher side. _slot holds _size bytes of its range.
+        auto fill(slot* _slot, std::size_t _size) -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                _slot->size = _size;
+                _slot->filled = true;
+            }
+
+            cv_.notify_all();
+        }
+
+        // Consumer side. Blocks until the next range in stream order is
+        // filled. Returns nullptr after the last range or on cancellation.
+        auto next() -> slot*
+        {
+            std::unique_lock lk{mtx_};
+
+            if (consumed_ == range_count_) {
+                return nullptr;
+            }
+
+            auto* s = slots_[consumed_ % slots_.size()].get();
+            cv_.wait(lk, [&] { return cancelled_ || s->filled; });
+
+            return cancelled_ ? nullptr : s;
+        }
+
+        // Consumer side. Frees the buffer returned by next().
+        auto release(slot* _slot) -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                _slot->filled = false;
+                ++consumed_;
+            }
+
+            cv_.notify_all();
+        }
+
+        // Either side. Stops everyone, e.g. after an error.
+        auto cancel() -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                cancelled_ = true;
+            }
+
+            cv_.notify_all();
+        }
+
+    private:
+        const std::uint64_t range_count_;
+        std::vector<std::unique_ptr<slot>> slots_;
+
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        std::uint64_t consumed_ = 0;
+        bool cancelled_ = false;
+    }; // class range_window
+} // namespace irods::cli
+
+#endif // IRODS_CLI_RANGE_WINDOW_HPP
@@ -0,0 +1,199 @@
+#ifndef IRODS_CLI_RATE_LIMITER_HPP
+#define IRODS_CLI_RATE_LIMITER_HPP
+
+#include "byte_size.hpp"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace irods::cli
+{
+    // Limits how fast units (bytes, opens, ...) are consumed by any number of
+    // threads, using the generic cell rate algorithm.
+    //
+    // The only shared state is the time at which the limiter would be idle again
+    // if every unit handed out so far were spread at the configured rate. Taking
+    // units moves that time forward with one compare-and-swap; if it ends up
+    // more than the burst allowance ahead of the clock, the caller sleeps off
+    // the difference. No lock is taken, and an unlimited limiter costs a single
+    // atomic load.
+    //
+    // The rate may be changed at any time. A change forgives the debt built up
+    // at the old rate, and callers that are sleeping wake up early to pick up
+    // the new rate.
+    class rate_limiter
+    {
+    public:
+        // A rate of zero means unlimited.
+        explicit rate_limiter(std::uint64_t _rate = 0,
+                              std::chrono::nanoseconds _burst = std::chrono::milliseconds{100})
+            : rate_{_rate}
+            , burst_ns_{_burst.count()}
+        {
+        }
+
+        rate_limiter(const rate_limiter&) = delete;
+        auto operator=(const rate_limiter&) -> rate_limiter& = delete;
+
+        auto rate() const noexcept -> std::uint64_t
+        {
+            return rate_.load(std::memory_order_relaxed);
+        }
+
+        auto set_rate(std::uint64_t _rate) noexcept -> void
+        {
+            rate_.store(_rate, std::memory_order_relaxed);
+            idle_at_ns_.store(now_ns(), std::memory_order_relaxed);
+            generation_.fetch_add(1, std::memory_order_release);
+        }
+
+        // Blocks until _units may be consumed.
+        auto acquire(std::uint64_t _units) -> void
+        {
+            const auto rate = rate_.load(std::memory_order_relaxed);
+
+            if (rate == 0 || _units == 0) {
+                return;
+            }
+
+            const auto generation = generation_.load(std::memory_order_acquire);
+            const auto cost = static_cast<std::int64_t>(static_cast<double>(_units) * 1e9 / static_cast<double>(rate));
+
+            auto idle_at = idle_at_ns_.load(std::memory_order_relaxed);
+            std::int64_t now = 0;
+            std::int64_t next = 0;
+
+            do {
+                now = now_ns();
+                next = std::max(idle_at, now) + cost;
+            } while (!idle_at_ns_.compare_exchange_weak(idle_at, next, std::memory_order_relaxed));
+
+            // Sleep in slices so that a rate change takes effect promptly.
+            for (auto wait = next - burst_ns_ - now; wait > 0; wait = next - burst_ns_ - now_ns()) {
+                if (generation_.load(std::memory_order_acquire) != generation) {
+                    return;
+                }
+
+                std::this_thread::sleep_for(std::chrono::nanoseconds{std::min<std::int64_t>(wait, max_sleep_ns)});
+            }
+        }
+
+    private:
+        static constexpr std::int64_t max_sleep_ns = 50'000'000;
+
+        static auto now_ns() noexcept -> std::int64_t
+        {
+            using namespace std::chrono;
+            return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        }
+
+        std::atomic<std::uint64_t> rate_;
+        const std::int64_t burst_ns_;
+        std::atomic<std::int64_t> idle_at_ns_{0};
+        std::atomic<std::uint64_t> generation_{0};
+    }; // class rate_limiter
+
+    // The limits every transfer thread of a command draws from.
+    struct transfer_limits
+    {
+        rate_limiter bandwidth; // Bytes per second.
+        rate_limiter opens;     // Data objects opened per second.
+    };
+
+    // Applies the limits written to a file while a job is running, so that they
+    // can be changed without restarting it. The file is checked once a second
+    // and re-read whenever its modification time changes. It holds one limit per
+    // line, named after the command line options:
+    //
+    //     max-bandwidth 200M
+    //     max-opens 500
+    //
+    // A limit that is missing from the file is left as it is; a value of 0
+    // lifts it.
+    class limits_file_watcher
+    {
+    public:
+        limits_file_watcher(std::string _path, transfer_limits& _limits)
+            : path_{std::move(_path)}
+            , limits_{_limits}
+            , thread_{[this] { run(); }}
+        {
+        }
+
+        limits_file_watcher(const limits_file_watcher&) = delete;
+        auto operator=(const limits_file_watcher&) -> limits_file_watcher& = delete;
+
+        ~limits_file_watcher()
+        {
+            {
+                std::lock_guard lk{mtx_};
+                stop_ = true;
+            }
+
+            cv_.notify_all();
+            thread_.join();
+        }
+
+    private:
+        auto run() -> void
+        {
+            std::int64_t loaded_mtime_ns = -1;
+            std::unique_lock lk{mtx_};
+
+            do {
+                struct stat st;
+
+                if (::stat(path_.c_str(), &st) == 0) {
+                    const auto mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+
+                    if (mtime_ns != loaded_mtime_ns) {
+                        loaded_mtime_ns = mtime_ns;
+                        load();
+                    }
+                }
+            } while (!cv_.wait_for(lk, std::chrono::seconds{1}, [this] { return stop_; }));
+        }
+
+        auto load() -> void
+        {
+            std::ifstream in{path_};
+
+            for (std::string key, value; in >> key >> value;) {
+                if (key == "max-bandwidth") {
+                    if (const auto rate = parse_byte_size(value); rate) {
+                        limits_.bandwidth.set_rate(*rate);
+                        continue;
+                    }
+                }
+                else if (key == "max-opens") {
+                    if (value.size() <= 18 && value.find_first_not_of("0123456789") == std::string::npos) {
+                        limits_.opens.set_rate(std::stoull(value));
+                        continue;
+                    }
+                }
+
+                std::cerr << "Warning: Ignoring invalid limit [path: " << path_ << ", limit: " << key << ' ' << value
+                          << "].\n";
+            }
+        }
+
+        const std::string path_;
+        transfer_limits& limits_;
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        bool stop_ = false;
+        std::thread thread_;
+    }; // class limits_file_watcher
+} // namespace irods::cli
+
+#endif // IRODS_CLI_RATE_LIMITER_HPP
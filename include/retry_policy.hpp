@@ -0,0 +1,42 @@
+#ifndef IRODS_CLI_RETRY_POLICY_HPP
+#define IRODS_CLI_RETRY_POLICY_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace irods::cli
+{
+    // How often and how patiently a failed unit of work is attempted again.
+    //
+    // The delay doubles with every attempt up to a cap, and is jittered so that
+    // streams which failed together (e.g. after a network blip) do not all
+    // reconnect at the same moment.
+    struct retry_policy
+    {
+        int retries = 3;
+        std::chrono::milliseconds initial_delay{250};
+        std::chrono::milliseconds max_delay{10'000};
+
+        // Delay before retry number _attempt, counting from zero.
+        auto delay(int _attempt) const -> std::chrono::milliseconds
+        {
+            thread_local std::minstd_rand rng{std::random_device{}()};
+
+            auto d = initial_delay;
+
+            for (int i = 0; i < _attempt && d < max_delay; ++i) {
+                d *= 2;
+            }
+
+            d = std::min(d, max_delay);
+
+            // Somewhere between half and all of the nominal delay.
+            std::uniform_int_distribution<long long> jitter{d.count() / 2, d.count()};
+
+            return std::chrono::milliseconds{jitter(rng)};
+        }
+    };
+} // namespace irods::cli
+
+#endif // IRODS_CLI_RETRY_POLICY_HPP
@@ -0,0 +1,293 @@
+#ifndef IRODS_CLI_SHA256_DIGEST_HPP
+#define IRODS_CLI_SHA256_DIGEST_HPP
+
+#include <irods/rodsClient.h>
+#include <irods/irods_query.hpp>
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace irods::cli
+{
+    // Incremental SHA-256 over the bytes a transfer is already moving.
+    class sha256_digest
+    {
+    public:
+        sha256_digest()
+            : ctx_{EVP_MD_CTX_new()}
+        {
+            if (!ctx_ || EVP_DigestInit_ex(ctx_.get(), EVP_sha256(), nullptr) != 1) {
+                throw std::runtime_error{"Cannot initialize SHA-256."};
+            }
+        }
+
+        auto update(const char* _data, std::size_t _size) -> void
+        {
+            if (EVP_DigestUpdate(ctx_.get(), _data, _size) != 1) {
+                throw std::runtime_error{"Cannot update SHA-256."};
+            }
+        }
+
+        // May only be called once.
+        auto finish() -> std::string
+        {
+            unsigned char md[EVP_MAX_MD_SIZE];
+            unsigned int size = 0;
+
+            if (EVP_DigestFinal_ex(ctx_.get(), md, &size) != 1) {
+                throw std::runtime_error{"Cannot finalize SHA-256."};
+            }
+
+            return std::string(reinterpret_cast<const char*>(md), size);
+        }
+
+        // The form iRODS stores SHA-256 checksums in: "sha2:" followed by the
+        // base64 encoded digest.
+        static auto to_irods_checksum(const std::string& _digest) -> std::string
+        {
+            std::string encoded(4 * ((_digest.size() + 2) / 3) + 1, '\0');
+            const auto n = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(encoded.data()),
+                                           reinterpret_cast<const unsigned char*>(_digest.data()),
+                                           static_cast<int>(_digest.size()));
+            encoded.resize(static_cast<std::size_t>(n));
+
+            return "sha2:" + encoded;
+        }
+
+    private:
+        struct ctx_deleter
+        {
+            auto operator()(EVP_MD_CTX* _ctx) const noexcept -> void
+            {
+                EVP_MD_CTX_free(_ctx);
+            }
+        };
+
+        std::unique_ptr<EVP_MD_CTX, ctx_deleter> ctx_;
+    }; // class sha256_digest
+
+    // Computes the digest of a stream whose pieces arrive out of order, e.g.
+    // from the parallel streams of a chunked transfer.
+    //
+    // SHA-256 cannot be split and merged, so the bytes must be hashed in order.
+    // A piece that continues the hashed prefix is hashed straight away, along
+    // with any held pieces it makes contiguous; other pieces are copied and
+    // held. Once the held bytes reach the cap, callers with out-of-order pieces
+    // wait. The caller that owns the next piece never waits, so the transfer
+    // always makes progress.
+    //
+    // Pieces may be fed twice (e.g. when a chunk is retried); bytes that were
+    // already hashed are ignored. If a piece will never arrive, call
+    // abandon() so that waiting callers are released.
+    class digest_sequencer
+    {
+    public:
+        explicit digest_sequencer(std::size_t _max_held_bytes)
+            : max_held_bytes_{_max_held_bytes}
+        {
+        }
+
+        digest_sequencer(const digest_sequencer&) = delete;
+        auto operator=(const digest_sequencer&) -> digest_sequencer& = delete;
+
+        auto feed(std::uint64_t _offset, const char* _data, std::size_t _size) -> void
+        {
+            std::unique_lock lk{mtx_};
+
+            if (abandoned_) {
+                return;
+            }
+
+            // Drop whatever was hashed already.
+            if (_offset < next_) {
+                const auto skip = std::min<std::uint64_t>(next_ - _offset, _size);
+                _offset += skip;
+                _data += skip;
+                _size -= static_cast<std::size_t>(skip);
+            }
+
+            if (_size == 0) {
+                return;
+            }
+
+            if (_offset == next_) {
+                digest_.update(_data, _size);
+                next_ += _size;
+                drain();
+                cv_.notify_all();
+                return;
+            }
+
+            cv_.wait(lk, [&] { return abandoned_ || held_bytes_ < max_held_bytes_ || _offset <= next_; });
+
+            if (abandoned_) {
+                return;
+            }
+
+            // The prefix may have caught up while waiting.
+            if (_offset <= next_) {
+                lk.unlock();
+                feed(_offset, _data, _size);
+                return;
+            }
+
+            // A retry may cut its pieces differently; the longer one is kept.
+            if (auto& bytes = held_[_offset]; bytes.size() < _size) {
+                held_bytes_ += _size - bytes.size();
+                bytes.assign(_data, _data + _size);
+            }
+        }
+
+        auto abandon() -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                abandoned_ = true;
+                held_.clear();
+                held_bytes_ = 0;
+            }
+
+            cv_.notify_all();
+        }
+
+        // Returns the digest if every byte of a stream of _size bytes has been
+        // hashed. May only be called once.
+        auto finish(std::uint64_t _size) -> std::optional<std::string>
+        {
+            std::lock_guard lk{mtx_};
+
+            if (abandoned_ || next_ != _size || !held_.empty()) {
+                return std::nullopt;
+            }
+
+            return digest_.finish();
+        }
+
+    private:
+        // Expects the mutex to be held.
+        auto drain() -> void
+        {
+            for (auto iter = held_.begin(); iter != held_.end() && iter->first <= next_;) {
+                const auto& [offset, bytes] = *iter;
+                const auto skip = std::min<std::uint64_t>(next_ - offset, bytes.size());
+
+                if (skip < bytes.size()) {
+                    digest_.update(bytes.data() + skip, bytes.size() - skip);
+                    next_ += bytes.size() - skip;
+                }
+
+                held_bytes_ -= bytes.size();
+                iter = held_.erase(iter);
+            }
+        }
+
+        const std::size_t max_held_bytes_;
+
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        sha256_digest digest_;
+        std::uint64_t next_ = 0;
+        std::map<std::uint64_t, std::vector<char>> held_;
+        std::size_t held_bytes_ = 0;
+        bool abandoned_ = false;
+    }; // class digest_sequencer
+
+    namespace detail
+    {
+        // The checksum stored for a good replica of a data object, or an empty
+        // string if there is none. Never makes the server compute one.
+        inline auto stored_checksum(rcComm_t& _comm, const std::string& _path) -> std::string
+        {
+            const auto slash = _path.find_last_of('/');
+
+            // GenQuery cannot escape quotes, so such paths cannot be looked up.
+            if (slash == std::string::npos || _path.find('\'') != std::string::npos) {
+                return {};
+            }
+
+            const auto collection = slash == 0 ? std::string{"/"} : _path.substr(0, slash);
+            const auto gql = "SELECT DATA_CHECKSUM WHERE COLL_NAME = '" + collection + "' AND DATA_NAME = '" +
+                             _path.substr(slash + 1) + "' AND DATA_REPL_STATUS = '1'";
+
+            for (auto&& row : irods::query<rcComm_t>{&_comm, gql}) {
+                if (!row.at(0).empty()) {
+                    return row.at(0);
+                }
+            }
+
+            return {};
+        }
+
+        // True if the client environment names SHA-256 as the zone's default
+        // hash scheme, i.e. a checksum the server computes will be comparable.
+        inline auto zone_uses_sha256() -> bool
+        {
+            rodsEnv env{};
+
+            if (getRodsEnv(&env) < 0) {
+                return false;
+            }
+
+            const std::string_view scheme = env.rodsDefaultHashScheme;
+
+            return scheme == "SHA256" || scheme == "sha256";
+        }
+    } // namespace detail
+
+    // Compares a locally computed digest with the SHA-256 checksum the server
+    // holds for the data object. Throws on a mismatch.
+    //
+    // A stored checksum is used as is. Only if there is none, and the zone
+    // uses SHA-256, is the server asked to compute one; the replica is never
+    // read again just to replace a checksum of another scheme. Returns false
+    // if nothing can be compared.
+    inline auto verify_checksum(rcComm_t& _comm, const std::string& _path, const std::string& _digest) -> bool
+    {
+        auto remote = detail::stored_checksum(_comm, _path);
+
+        if (remote.empty()) {
+            if (!detail::zone_uses_sha256()) {
+                return false;
+            }
+
+            dataObjInp_t input{};
+            rstrcpy(input.objPath, _path.c_str(), MAX_NAME_LEN);
+
+            char* checksum = nullptr;
+            const auto ec = rcDataObjChksum(&_comm, &input, &checksum);
+
+            if (ec < 0) {
+                std::free(checksum);
+                throw std::runtime_error{"Cannot get checksum [path: " + _path + ", error: " + std::to_string(ec) + "]."};
+            }
+
+            remote = checksum ? checksum : "";
+            std::free(checksum);
+        }
+
+        if (remote.rfind("sha2:", 0) != 0) {
+            return false;
+        }
+
+        if (const auto local = sha256_digest::to_irods_checksum(_digest); remote != local) {
+            throw std::runtime_error{"Checksum mismatch [path: " + _path + ", local: " + local + ", server: " +
+                                     remote + "]."};
+        }
+
+        return true;
+    }
+} // namespace irods::cli
+
+#endif // IRODS_CLI_SHA256_DIGEST_HPP
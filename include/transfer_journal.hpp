@@ -0,0 +1,335 @@
+#ifndef IRODS_CLI_TRANSFER_JOURNAL_HPP
+#define IRODS_CLI_TRANSFER_JOURNAL_HPP
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace irods::cli
+{
+    // Records which chunks of an upload have reached the server so that an
+    // interrupted upload can be resumed instead of restarted.
+    //
+    // The journal is a small text file. A header identifies the source file
+    // (path, size, modification time and inode), the target and the chunk size;
+    // every completed chunk appends one "done <index>" line. Lines are appended
+    // with O_APPEND in a single write, so all streams of a transfer may record
+    // completions concurrently and a crash loses at most the lines that were
+    // being written, which only means those chunks are sent again.
+    //
+    // A journal is only reused if its header matches the current source and
+    // target exactly. Its chunk size wins over a newly derived one, since the
+    // completed chunks are only meaningful with the size they were cut with.
+    class transfer_journal
+    {
+    public:
+        struct identity
+        {
+            std::uint64_t size;
+            std::int64_t mtime_ns;
+            std::uint64_t inode;
+
+            auto operator==(const identity& _other) const noexcept -> bool
+            {
+                return size == _other.size && mtime_ns == _other.mtime_ns && inode == _other.inode;
+            }
+        };
+
+        static auto identity_of(const std::string& _path) -> identity
+        {
+            struct stat st;
+
+            if (::stat(_path.c_str(), &st) != 0) {
+                throw std::runtime_error{"Cannot stat file [path: " + _path + ", error: " + std::strerror(errno) + "]."};
+            }
+
+            return {static_cast<std::uint64_t>(st.st_size),
+                    static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec,
+                    static_cast<std::uint64_t>(st.st_ino)};
+        }
+
+        // Without a state directory the journal lives next to the source as a
+        // hidden file. Within a state directory it is named after a hash of the
+        // source and target, so one directory can hold many journals.
+        static auto path_for(const std::string& _source, const std::string& _target, const std::string& _state_dir)
+            -> std::string
+        {
+            if (_state_dir.empty()) {
+                const auto slash = _source.find_last_of('/');
+                const auto dir = slash == std::string::npos ? std::string{} : _source.substr(0, slash + 1);
+                const auto name = slash == std::string::npos ? _source : _source.substr(slash + 1);
+
+                return dir + '.' + name + ".irods-put-journal";
+            }
+
+            // FNV-1a, because the name must not change between builds.
+            std::uint64_t hash = 14695981039346656037ULL;
+
+            for (const auto c : _source + '\n' + _target) {
+                hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+            }
+
+            char name[32];
+            std::snprintf(name, sizeof(name), "%016llx.journal", static_cast<unsigned long long>(hash));
+
+            return _state_dir + '/' + name;
+        }
+
+        transfer_journal(std::string _path, std::string _source, std::string _target, std::uint64_t _chunk_size)
+            : path_{std::move(_path)}
+            , source_{std::move(_source)}
+            , target_{std::move(_target)}
+            , identity_{identity_of(source_)}
+            , chunk_size_{std::max<std::uint64_t>(_chunk_size, 1)}
+        {
+            if (!load()) {
+                restart();
+            }
+            else {
+                open_for_append();
+            }
+        }
+
+        transfer_journal(const transfer_journal&) = delete;
+        auto operator=(const transfer_journal&) -> transfer_journal& = delete;
+
+        ~transfer_journal()
+        {
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+        }
+
+        // True if an earlier run of the same transfer left completed chunks behind.
+        auto resumed() const -> bool
+        {
+            return completed_count() > 0;
+        }
+
+        auto chunk_size() const noexcept -> std::uint64_t
+        {
+            return chunk_size_;
+        }
+
+        auto chunk_count() const noexcept -> std::uint64_t
+        {
+            return (identity_.size + chunk_size_ - 1) / chunk_size_;
+        }
+
+        // Completed chunks as recorded when the journal was opened.
+        auto completed() const -> const std::vector<bool>&
+        {
+            return completed_;
+        }
+
+        auto completed_count() const -> std::uint64_t
+        {
+            return static_cast<std::uint64_t>(std::count(std::begin(completed_), std::end(completed_), true));
+        }
+
+        auto path() const noexcept -> const std::string&
+        {
+            return path_;
+        }
+
+        // Thread-safe. Each chunk must be marked at most once.
+        auto mark_done(std::uint64_t _index) -> void
+        {
+            const auto line = "done " + std::to_string(_index) + '\n';
+
+            if (::write(fd_, line.data(), line.size()) != static_cast<ssize_t>(line.size())) {
+                throw std::runtime_error{"Cannot write journal [path: " + path_ + ", error: " + std::strerror(errno) +
+                                         "]."};
+            }
+
+            marked_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // True once every chunk has been recorded, in this run or an earlier one.
+        auto finished() const -> bool
+        {
+            return completed_count() + marked_.load(std::memory_order_relaxed) >= chunk_count();
+        }
+
+        // Forgets every completed chunk and starts a fresh journal.
+        auto restart() -> void
+        {
+            if (fd_ >= 0) {
+                ::close(fd_);
+                fd_ = -1;
+            }
+
+            completed_.assign(chunk_count(), false);
+            marked_ = 0;
+            torn_at_ = -1;
+
+            fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+
+            if (fd_ < 0) {
+                throw std::runtime_error{"Cannot create journal [path: " + path_ + ", error: " + std::strerror(errno) +
+                                         "]."};
+            }
+
+            const auto header = make_header();
+
+            if (::write(fd_, header.data(), header.size()) != static_cast<ssize_t>(header.size())) {
+                throw std::runtime_error{"Cannot write journal [path: " + path_ + ", error: " + std::strerror(errno) +
+                                         "]."};
+            }
+
+            ::close(fd_);
+            open_for_append();
+        }
+
+        // Called once the transfer has completed.
+        auto remove() -> void
+        {
+            ::unlink(path_.c_str());
+        }
+
+    private:
+        static constexpr const char* magic = "irods-put-journal 1";
+
+        auto make_header() const -> std::string
+        {
+            std::ostringstream os;
+            os << magic << '\n'
+               << "source " << source_ << '\n'
+               << "target " << target_ << '\n'
+               << "size " << identity_.size << '\n'
+               << "mtime " << identity_.mtime_ns << '\n'
+               << "inode " << identity_.inode << '\n'
+               << "chunk_size " << chunk_size_ << '\n';
+
+            return os.str();
+        }
+
+        // Returns false if there is no journal or it describes another transfer.
+        auto load() -> bool
+        {
+            std::ifstream in{path_};
+
+            if (!in) {
+                return false;
+            }
+
+            std::string line;
+
+            if (!std::getline(in, line) || line != magic) {
+                return false;
+            }
+
+            identity recorded{};
+            std::string source;
+            std::string target;
+            std::uint64_t chunk_size = 0;
+            std::vector<std::uint64_t> done;
+
+            for (auto line_start = in.tellg(); std::getline(in, line); line_start = in.tellg()) {
+                // A last line without a newline may have been cut short, e.g.
+                // "done 1" out of "done 12". It is ignored and cut off before
+                // anything else is appended.
+                if (in.eof()) {
+                    torn_at_ = static_cast<off_t>(line_start);
+                    break;
+                }
+
+                const auto space = line.find(' ');
+
+                if (space == std::string::npos) {
+                    continue; // Torn write.
+                }
+
+                const auto key = line.substr(0, space);
+                const auto value = line.substr(space + 1);
+
+                try {
+                    if (key == "done") {
+                        if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+                            continue;
+                        }
+
+                        done.push_back(std::stoull(value));
+                    }
+                    else if (key == "source") {
+                        source = value;
+                    }
+                    else if (key == "target") {
+                        target = value;
+                    }
+                    else if (key == "size") {
+                        recorded.size = std::stoull(value);
+                    }
+                    else if (key == "mtime") {
+                        recorded.mtime_ns = std::stoll(value);
+                    }
+                    else if (key == "inode") {
+                        recorded.inode = std::stoull(value);
+                    }
+                    else if (key == "chunk_size") {
+                        chunk_size = std::stoull(value);
+                    }
+                }
+                catch (const std::exception&) {
+                    continue; // Torn write.
+                }
+            }
+
+            if (source != source_ || target != target_ || !(recorded == identity_) || chunk_size == 0) {
+                return false;
+            }
+
+            chunk_size_ = chunk_size;
+            completed_.assign(chunk_count(), false);
+
+            for (const auto i : done) {
+                if (i < completed_.size()) {
+                    completed_[i] = true;
+                }
+            }
+
+            return true;
+        }
+
+        auto open_for_append() -> void
+        {
+            fd_ = ::open(path_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+
+            if (fd_ < 0) {
+                throw std::runtime_error{"Cannot open journal [path: " + path_ + ", error: " + std::strerror(errno) +
+                                         "]."};
+            }
+
+            if (torn_at_ >= 0 && ::ftruncate(fd_, torn_at_) != 0) {
+                throw std::runtime_error{"Cannot repair journal [path: " + path_ + ", error: " + std::strerror(errno) +
+                                         "]."};
+            }
+
+            torn_at_ = -1;
+        }
+
+        const std::string path_;
+        const std::string source_;
+        const std::string target_;
+        const identity identity_;
+        std::uint64_t chunk_size_;
+        std::vector<bool> completed_;
+        std::atomic<std::uint64_t> marked_{0};
+        off_t torn_at_ = -1;
+        int fd_ = -1;
+    }; // class transfer_journal
+} // namespace irods::cli
+
+#endif // IRODS_CLI_TRANSFER_JOURNAL_HPP
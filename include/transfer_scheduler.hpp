@@ -0,0 +1,397 @@
+#ifndef IRODS_CLI_TRANSFER_SCHEDULER_HPP
+#define IRODS_CLI_TRANSFER_SCHEDULER_HPP
+
+#include "bounded_queue.hpp"
+#include "chunk_scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <vector>
+
+namespace irods::cli
+{
+    template <typename Task, typename Context>
+    class transfer_scheduler;
+
+    // A file that is moved as parallel chunks. The worker that leads the transfer
+    // opens and finalizes the destination and stores whatever the helpers need to
+    // join it in the context before publishing it.
+    template <typename Task, typename Context>
+    class large_transfer
+    {
+    public:
+        large_transfer(Task _task, std::uint64_t _size, std::uint64_t _chunk_size, int _max_streams)
+            : task{std::move(_task)}
+            , chunks{_size, _chunk_size}
+            , context{}
+            , max_streams_{std::max(_max_streams, 1)}
+            , streams_{0}
+            , published_{false}
+            , closing_{false}
+        {
+        }
+
+        Task task;
+        chunk_scheduler chunks;
+        Context context;
+
+    private:
+        friend class transfer_scheduler<Task, Context>;
+
+        const int max_streams_;
+        int streams_;
+        bool published_;
+        bool closing_; // No helper may join once the leader waits to finalize.
+    }; // class large_transfer
+
+    // Decides which piece of work each worker does next when a job mixes small
+    // and large files.
+    //
+    // Large files are started biggest first and every idle worker joins the
+    // running large transfers (up to their stream limit) before starting a new
+    // one. A share of the workers is held back for small files while any are
+    // queued, so small files keep flowing between the large ones instead of
+    // piling up behind them.
+    //
+    // Tasks are fed in while workers run. Small files go through a bounded
+    // lock-free queue and pending large files are capped as well; once either
+    // is full the producer blocks, so memory stays flat no matter how many files
+    // the job holds. A worker that finds a large file among the small ones
+    // cannot block on the cap, since workers are what drains the pending set;
+    // it leads a large file itself instead (see promote()). Large files are
+    // ordered biggest first among those that are pending at the time.
+    //
+    // Every worker occupies at most one connection at a time, so a connection
+    // pool with as many connections as there are workers never runs dry.
+    template <typename Task, typename Context>
+    class transfer_scheduler
+    {
+    public:
+        using large_type = large_transfer<Task, Context>;
+        using large_pointer = std::shared_ptr<large_type>;
+
+        enum class work_kind
+        {
+            small,
+            lead,
+            join
+        };
+
+        struct work
+        {
+            work_kind kind;
+            Task task;
+            large_pointer large;
+        };
+
+        explicit transfer_scheduler(int _workers, std::size_t _queue_capacity = 4096)
+            : workers_{std::max(_workers, 1)}
+            , reserved_for_small_{workers_ > 1 ? std::max(1, workers_ / 4) : 0}
+            , max_pending_large_{std::max<std::size_t>(_queue_capacity / 16, static_cast<std::size_t>(workers_))}
+            , small_{_queue_capacity}
+        {
+        }
+
+        transfer_scheduler(const transfer_scheduler&) = delete;
+        auto operator=(const transfer_scheduler&) -> transfer_scheduler& = delete;
+
+        // Blocks while the small-file queue is full.
+        auto add_small(Task _task) -> void
+        {
+            small_.push(std::move(_task));
+
+            // Pairs with the fence in wait_for_work() so that a worker cannot go
+            // to sleep between failing to pop and this check.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (sleepers_.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard lk{mtx_};
+                cv_.notify_one();
+            }
+        }
+
+        // Blocks while too many large files are pending.
+        auto add_large(Task _task, std::uint64_t _size, std::uint64_t _chunk_size, int _max_streams) -> void
+        {
+            {
+                std::unique_lock lk{mtx_};
+                cv_.wait(lk, [this] { return pending_large_.size() < max_pending_large_; });
+                push_large(std::move(_task), _size, _chunk_size, _max_streams);
+            }
+
+            cv_.notify_all();
+        }
+
+        // Moves a task taken from the small-file queue to the large files once a
+        // worker has found out how big it is. Never blocks, because the worker
+        // would otherwise wait on the very workers that drain the pending set.
+        // If the pending set is full, the biggest pending file is started right
+        // away and returned; the caller must lead it as if next() had returned
+        // it, and the task takes its place. Returns nullptr otherwise.
+        auto promote(Task _task, std::uint64_t _size, std::uint64_t _chunk_size, int _max_streams) -> large_pointer
+        {
+            large_pointer lead;
+
+            {
+                std::lock_guard lk{mtx_};
+                push_large(std::move(_task), _size, _chunk_size, _max_streams);
+
+                if (pending_large_.size() > max_pending_large_) {
+                    lead = pending_large_.top();
+                    pending_large_.pop();
+                    start(lead);
+                }
+            }
+
+            cv_.notify_all();
+
+            return lead;
+        }
+
+        // Signals that no more tasks will be added.
+        auto close() -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                closed_ = true;
+            }
+
+            cv_.notify_all();
+        }
+
+        // Blocks until there is work for the calling worker. Returns an empty
+        // optional once everything has been handed out.
+        auto next() -> std::optional<work>
+        {
+            for (;;) {
+                // Small files never touch the mutex unless large files are in play.
+                if (large_count_.load(std::memory_order_acquire) > 0) {
+                    std::lock_guard lk{mtx_};
+
+                    if (auto w = next_large(); w) {
+                        return w;
+                    }
+                }
+
+                if (Task task; small_.try_pop(task)) {
+                    small_in_flight_.fetch_add(1, std::memory_order_relaxed);
+                    return work{work_kind::small, std::move(task), nullptr};
+                }
+
+                if (!wait_for_work()) {
+                    return std::nullopt;
+                }
+            }
+        }
+
+        // Takes another queued small task without blocking, so that a worker can
+        // batch the local reads of several small files. Every task returned must
+        // be completed with complete_small().
+        auto try_next_small() -> std::optional<Task>
+        {
+            if (Task task; small_.try_pop(task)) {
+                small_in_flight_.fetch_add(1, std::memory_order_relaxed);
+                return task;
+            }
+
+            return std::nullopt;
+        }
+
+        // Called by a worker once it is done with a small task (uploaded or
+        // promoted). Idle workers stay around until then, because the task may
+        // still turn into a large file they can help with.
+        auto complete_small() -> void
+        {
+            if (small_in_flight_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard lk{mtx_};
+                cv_.notify_all();
+            }
+        }
+
+        // Called by the leader once helpers may join the transfer.
+        auto publish(const large_pointer& _large) -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                _large->published_ = true;
+            }
+
+            cv_.notify_all();
+        }
+
+        // Called by a helper after it has closed its stream.
+        auto leave(const large_pointer& _large) -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                --_large->streams_;
+                --large_workers_;
+            }
+
+            cv_.notify_all();
+        }
+
+        // Called by the leader before it finalizes the destination. No helper
+        // joins from then on, even if a unit is handed back and the transfer
+        // has work again; the leader sends such units itself.
+        auto wait_for_helpers(const large_pointer& _large) -> void
+        {
+            std::unique_lock lk{mtx_};
+            _large->closing_ = true;
+            cv_.wait(lk, [&_large] { return _large->streams_ == 1; });
+        }
+
+        // Called by the leader after it has finalized (or given up on) the destination.
+        auto finish(const large_pointer& _large) -> void
+        {
+            {
+                std::lock_guard lk{mtx_};
+                active_large_.erase(std::remove(std::begin(active_large_), std::end(active_large_), _large),
+                                    std::end(active_large_));
+                --_large->streams_;
+                --large_workers_;
+                large_count_.fetch_sub(1, std::memory_order_release);
+            }
+
+            cv_.notify_all();
+        }
+
+    private:
+        struct smaller_first
+        {
+            auto operator()(const large_pointer& _lhs, const large_pointer& _rhs) const noexcept -> bool
+            {
+                return _lhs->chunks.total_size() < _rhs->chunks.total_size();
+            }
+        };
+
+        // Expects the mutex to be held.
+        auto push_large(Task _task, std::uint64_t _size, std::uint64_t _chunk_size, int _max_streams) -> void
+        {
+            pending_large_.push(std::make_shared<large_type>(std::move(_task), _size, _chunk_size, _max_streams));
+            large_count_.fetch_add(1, std::memory_order_release);
+        }
+
+        // Makes the calling worker the leader of _large. Expects the mutex to be held.
+        auto start(const large_pointer& _large) -> void
+        {
+            _large->streams_ = 1;
+            active_large_.push_back(_large);
+            ++large_workers_;
+        }
+
+        // Expects the mutex to be held.
+        auto next_large() -> std::optional<work>
+        {
+            if (large_workers_ >= large_slots()) {
+                return std::nullopt;
+            }
+
+            if (auto l = joinable(); l) {
+                ++l->streams_;
+                ++large_workers_;
+                return work{work_kind::join, Task{}, std::move(l)};
+            }
+
+            if (!pending_large_.empty()) {
+                auto l = pending_large_.top();
+                pending_large_.pop();
+                start(l);
+
+                // A producer may be waiting for room in the pending set.
+                cv_.notify_all();
+
+                return work{work_kind::lead, Task{}, std::move(l)};
+            }
+
+            return std::nullopt;
+        }
+
+        // Returns false once no more work can arrive.
+        auto wait_for_work() -> bool
+        {
+            std::unique_lock lk{mtx_};
+
+            sleepers_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (small_.size_approx() == 0 && !next_large_ready()) {
+                if (closed_ && pending_large_.empty() && !has_unclaimed_chunks() &&
+                    small_in_flight_.load(std::memory_order_acquire) == 0)
+                {
+                    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                    return false;
+                }
+
+                // Bounded so that a wakeup missed by the lock-free fast path only
+                // costs a short delay.
+                cv_.wait_for(lk, std::chrono::milliseconds{50});
+            }
+
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        // Expects the mutex to be held.
+        auto next_large_ready() const -> bool
+        {
+            return large_workers_ < large_slots() && (joinable() || !pending_large_.empty());
+        }
+
+        auto large_slots() const noexcept -> int
+        {
+            return small_.size_approx() == 0 ? workers_ : workers_ - reserved_for_small_;
+        }
+
+        auto joinable() const -> large_pointer
+        {
+            for (auto&& l : active_large_) {
+                if (l->published_ && !l->closing_ && l->streams_ < l->max_streams_ && !l->chunks.exhausted()) {
+                    return l;
+                }
+            }
+
+            return nullptr;
+        }
+
+        // True if a running transfer may still accept helpers, in which case
+        // idle workers wait instead of exiting.
+        auto has_unclaimed_chunks() const -> bool
+        {
+            return std::any_of(std::begin(active_large_), std::end(active_large_), [](auto&& l) {
+                return !l->closing_ && l->streams_ < l->max_streams_ && !l->chunks.exhausted();
+            });
+        }
+
+        const int workers_;
+        const int reserved_for_small_;
+        const std::size_t max_pending_large_;
+
+        std::mutex mtx_;
+        std::condition_variable cv_;
+
+        bounded_queue<Task> small_;
+        std::atomic<int> small_in_flight_{0};
+        std::atomic<int> sleepers_{0};
+
+        // Guarded by the mutex.
+        std::priority_queue<large_pointer, std::vector<large_pointer>, smaller_first> pending_large_;
+        std::vector<large_pointer> active_large_;
+        int large_workers_ = 0;
+        bool closed_ = false;
+
+        // Number of pending and active large files; lets next() skip the mutex.
+        std::atomic<int> large_count_{0};
+    }; // class transfer_scheduler
+} // namespace irods::cli
+
+#endif // IRODS_CLI_TRANSFER_SCHEDULER_HPP
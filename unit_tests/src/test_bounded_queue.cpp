@@ -0,0 +1,108 @@
+#include <catch2/catch.hpp>
+
+#include "bounded_queue.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using irods::cli::bounded_queue;
+
+TEST_CASE("bounded_queue rounds its capacity up to a power of two")
+{
+    CHECK(bounded_queue<int>{1}.capacity() == 2);
+    CHECK(bounded_queue<int>{5}.capacity() == 8);
+    CHECK(bounded_queue<int>{64}.capacity() == 64);
+}
+
+TEST_CASE("bounded_queue is first in, first out")
+{
+    bounded_queue<int> q{4};
+    int value = 0;
+
+    REQUIRE_FALSE(q.try_pop(value));
+
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(q.try_push(int{i}));
+    }
+
+    SECTION("a full queue rejects pushes")
+    {
+        CHECK_FALSE(q.try_push(4));
+        CHECK(q.size_approx() == 4);
+    }
+
+    SECTION("values come out in the order they went in")
+    {
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(q.try_pop(value));
+            CHECK(value == i);
+        }
+
+        CHECK_FALSE(q.try_pop(value));
+        CHECK(q.size_approx() == 0);
+    }
+
+    SECTION("slots are reused after wrapping around")
+    {
+        for (int i = 4; i < 100; ++i) {
+            REQUIRE(q.try_pop(value));
+            CHECK(value == i - 4);
+            REQUIRE(q.try_push(int{i}));
+        }
+    }
+}
+
+TEST_CASE("bounded_queue hands every value to exactly one consumer")
+{
+    constexpr int producers = 4;
+    constexpr int consumers = 4;
+    constexpr int per_producer = 20000;
+
+    bounded_queue<int> q{16};
+    std::vector<std::vector<int>> seen(consumers);
+    std::vector<std::thread> threads;
+
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&q, p] {
+            for (int i = 0; i < per_producer; ++i) {
+                q.push(p * per_producer + i);
+            }
+        });
+    }
+
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&q, &seen, c] {
+            for (int n = 0; n < producers * per_producer / consumers;) {
+                if (int value; q.try_pop(value)) {
+                    seen[c].push_back(value);
+                    ++n;
+                }
+                else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (auto&& t : threads) {
+        t.join();
+    }
+
+    std::vector<int> count(producers * per_producer);
+
+    for (auto&& values : seen) {
+        // Each producer's values reach a consumer in the order they were pushed.
+        std::vector<int> last(producers, -1);
+
+        for (const auto v : values) {
+            ++count[v];
+            CHECK(v > last[v / per_producer]);
+            last[v / per_producer] = v;
+        }
+    }
+
+    for (const auto n : count) {
+        REQUIRE(n == 1);
+    }
+}
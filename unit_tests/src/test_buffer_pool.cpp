@@ -0,0 +1,81 @@
+#include <catch2/catch.hpp>
+
+#include "buffer_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace irods::cli;
+
+namespace
+{
+    // Lifts the memory limit again when a test is done with it.
+    struct unlimited_on_exit
+    {
+        ~unlimited_on_exit()
+        {
+            buffer_pool::instance().configure(0, false);
+        }
+    };
+} // anonymous namespace
+
+TEST_CASE("buffer_pool hands out page-aligned buffers")
+{
+    auto buffers = buffer_pool::instance().acquire(3, 5000);
+
+    REQUIRE(buffers.size() == 3);
+
+    for (auto&& b : buffers) {
+        CHECK(b.size() >= 5000);
+        CHECK(b.size() % aligned_buffer::alignment == 0);
+        CHECK(reinterpret_cast<std::uintptr_t>(b.data()) % aligned_buffer::alignment == 0);
+    }
+}
+
+TEST_CASE("buffer_pool reuses returned buffers")
+{
+    char* data = nullptr;
+
+    {
+        auto b = buffer_pool::instance().acquire(12345);
+        data = b.data();
+    }
+
+    CHECK(buffer_pool::instance().acquire(12345).data() == data);
+}
+
+TEST_CASE("buffer_pool waits for room under a memory limit")
+{
+    unlimited_on_exit restore;
+    buffer_pool::instance().configure(2 * aligned_buffer::alignment, false);
+
+    REQUIRE(buffer_pool::instance().memory_limit() == 2 * aligned_buffer::alignment);
+
+    auto held = buffer_pool::instance().acquire(2, aligned_buffer::alignment);
+    std::atomic<bool> granted{false};
+
+    std::thread waiter{[&] {
+        auto b = buffer_pool::instance().acquire(aligned_buffer::alignment);
+        granted = true;
+    }};
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    CHECK_FALSE(granted);
+
+    held.pop_back();
+    waiter.join();
+    CHECK(granted);
+}
+
+TEST_CASE("buffer_pool grants a request above the limit once nothing else is on loan")
+{
+    unlimited_on_exit restore;
+    buffer_pool::instance().configure(aligned_buffer::alignment, false);
+
+    auto b = buffer_pool::instance().acquire(4, aligned_buffer::alignment);
+
+    CHECK(b.size() == 4);
+}
@@ -0,0 +1,42 @@
+#include <catch2/catch.hpp>
+
+#include "byte_size.hpp"
+
+#include <cstdint>
+
+using namespace irods::cli;
+
+TEST_CASE("parse_byte_size accepts plain numbers and binary units")
+{
+    CHECK(parse_byte_size("0") == 0);
+    CHECK(parse_byte_size("4096") == 4096);
+    CHECK(parse_byte_size("10B") == 10);
+    CHECK(parse_byte_size("64K") == 64 * kibibyte);
+    CHECK(parse_byte_size("64k") == 64 * kibibyte);
+    CHECK(parse_byte_size("32MB") == 32 * mebibyte);
+    CHECK(parse_byte_size("32MiB") == 32 * mebibyte);
+    CHECK(parse_byte_size("2g") == 2 * gibibyte);
+    CHECK(parse_byte_size("1T") == tebibyte);
+    CHECK(parse_byte_size("18446744073709551615") == UINT64_MAX);
+}
+
+TEST_CASE("parse_byte_size rejects malformed sizes")
+{
+    CHECK_FALSE(parse_byte_size(""));
+    CHECK_FALSE(parse_byte_size("M"));
+    CHECK_FALSE(parse_byte_size("-1"));
+    CHECK_FALSE(parse_byte_size(" 1"));
+    CHECK_FALSE(parse_byte_size("1 M"));
+    CHECK_FALSE(parse_byte_size("1.5G"));
+    CHECK_FALSE(parse_byte_size("1P"));
+    CHECK_FALSE(parse_byte_size("1MX"));
+    CHECK_FALSE(parse_byte_size("1Mb!"));
+}
+
+TEST_CASE("parse_byte_size rejects sizes that do not fit in 64 bits")
+{
+    CHECK_FALSE(parse_byte_size("18446744073709551616"));
+    CHECK_FALSE(parse_byte_size("99999999999999999999999"));
+    CHECK_FALSE(parse_byte_size("16777216T"));
+    CHECK(parse_byte_size("16777215T") == 16777215 * tebibyte);
+}
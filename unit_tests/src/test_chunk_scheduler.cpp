@@ -0,0 +1,241 @@
+#include <catch2/catch.hpp>
+
+#include "chunk_scheduler.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace irods::cli;
+
+TEST_CASE("chunk_scheduler covers the range in ascending order")
+{
+    chunk_scheduler scheduler{10, 4};
+
+    REQUIRE(scheduler.chunk_count() == 3);
+
+    const auto a = scheduler.next();
+    const auto b = scheduler.next();
+    const auto c = scheduler.next();
+
+    REQUIRE((a && b && c));
+    CHECK((a->index == 0 && a->offset == 0 && a->size == 4));
+    CHECK((b->index == 1 && b->offset == 4 && b->size == 4));
+    CHECK((c->index == 2 && c->offset == 8 && c->size == 2));
+
+    CHECK_FALSE(scheduler.next());
+    CHECK(scheduler.exhausted());
+}
+
+TEST_CASE("chunk_scheduler handles empty ranges")
+{
+    chunk_scheduler scheduler{0, 4};
+
+    CHECK(scheduler.chunk_count() == 0);
+    CHECK_FALSE(scheduler.next());
+    CHECK(scheduler.exhausted());
+}
+
+TEST_CASE("chunk_scheduler skips chunks that are already done")
+{
+    chunk_scheduler scheduler{16, 4};
+    scheduler.skip({true, false, true, false});
+
+    const auto a = scheduler.next();
+    const auto b = scheduler.next();
+
+    REQUIRE((a && b));
+    CHECK(a->index == 1);
+    CHECK(b->index == 3);
+    CHECK_FALSE(scheduler.next());
+}
+
+TEST_CASE("chunk_scheduler tracks completed chunks")
+{
+    chunk_scheduler scheduler{16, 4};
+    scheduler.skip({true, false, false, false});
+
+    std::vector<chunk> taken;
+
+    while (const auto c = scheduler.next()) {
+        taken.push_back(*c);
+    }
+
+    REQUIRE(taken.size() == 3);
+    CHECK(scheduler.exhausted());
+
+    // Handed out is not done.
+    CHECK_FALSE(scheduler.all_done());
+
+    scheduler.mark_done(taken[0]);
+    scheduler.mark_done(taken[2]);
+    CHECK_FALSE(scheduler.all_done());
+
+    scheduler.mark_done(taken[1]);
+    CHECK(scheduler.all_done());
+}
+
+TEST_CASE("chunk_scheduler hands requeued chunks out first")
+{
+    chunk_scheduler scheduler{12, 4};
+
+    const auto a = scheduler.next();
+    const auto b = scheduler.next();
+    const auto c = scheduler.next();
+    REQUIRE((a && b && c));
+    REQUIRE(scheduler.exhausted());
+
+    scheduler.requeue(*b);
+    CHECK_FALSE(scheduler.exhausted());
+
+    const auto again = scheduler.next();
+    REQUIRE(again);
+    CHECK((again->index == 1 && again->offset == 4 && again->size == 4));
+    CHECK(scheduler.exhausted());
+    CHECK_FALSE(scheduler.next());
+
+    scheduler.mark_done(*a);
+    scheduler.mark_done(*again);
+    scheduler.mark_done(*c);
+    CHECK(scheduler.all_done());
+}
+
+TEST_CASE("chunk_scheduler hands each chunk to one worker")
+{
+    constexpr std::uint64_t count = 100000;
+
+    chunk_scheduler scheduler{count * 3 - 1, 3};
+    std::mutex mtx;
+    std::vector<std::uint64_t> taken;
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&] {
+            std::vector<std::uint64_t> mine;
+
+            while (const auto c = scheduler.next()) {
+                mine.push_back(c->index);
+            }
+
+            std::lock_guard lk{mtx};
+            taken.insert(std::end(taken), std::begin(mine), std::end(mine));
+        });
+    }
+
+    for (auto&& t : threads) {
+        t.join();
+    }
+
+    std::sort(std::begin(taken), std::end(taken));
+
+    REQUIRE(taken.size() == count);
+
+    for (std::uint64_t i = 0; i < count; ++i) {
+        REQUIRE(taken[i] == i);
+    }
+}
+
+TEST_CASE("make_transfer_plan")
+{
+    SECTION("small files are moved over one connection")
+    {
+        const auto plan = make_transfer_plan(4 * mebibyte, {});
+
+        CHECK_FALSE(plan.parallel);
+        CHECK(plan.connections == 1);
+        CHECK(plan.chunk_size == 4 * mebibyte);
+    }
+
+    SECTION("large files are split into whole mebibytes within bounds")
+    {
+        const auto plan = make_transfer_plan(10 * gibibyte, {});
+
+        CHECK(plan.parallel);
+        CHECK(plan.connections >= 2);
+        CHECK(plan.connections <= 16);
+        CHECK(plan.chunk_size % mebibyte == 0);
+        CHECK(plan.chunk_size >= 8 * mebibyte);
+        CHECK(plan.chunk_size <= 256 * mebibyte);
+    }
+
+    SECTION("faster links get more connections")
+    {
+        transfer_tuning slow;
+        slow.link_speed_gbps = 1;
+
+        transfer_tuning fast;
+        fast.link_speed_gbps = 100;
+
+        CHECK(make_transfer_plan(100 * gibibyte, slow).connections <
+              make_transfer_plan(100 * gibibyte, fast).connections);
+    }
+
+    SECTION("explicit settings are honored")
+    {
+        transfer_tuning tuning;
+        tuning.connections = 3;
+        tuning.chunk_size = 16 * mebibyte;
+
+        const auto plan = make_transfer_plan(gibibyte, tuning);
+
+        CHECK(plan.parallel);
+        CHECK(plan.connections == 3);
+        CHECK(plan.chunk_size == 16 * mebibyte);
+    }
+
+    SECTION("there are never more connections than chunks")
+    {
+        transfer_tuning tuning;
+        tuning.connections = 16;
+        tuning.chunk_size = 16 * mebibyte;
+
+        const auto plan = make_transfer_plan(40 * mebibyte, tuning);
+
+        CHECK(plan.parallel);
+        CHECK(plan.connections == 3);
+    }
+
+    SECTION("files smaller than two chunks are not split")
+    {
+        transfer_tuning tuning;
+        tuning.chunk_size = 64 * mebibyte;
+
+        CHECK_FALSE(make_transfer_plan(100 * mebibyte, tuning).parallel);
+        CHECK(make_transfer_plan(128 * mebibyte, tuning).parallel);
+    }
+}
+
+TEST_CASE("make_stream_plan")
+{
+    SECTION("streams without a size hint use one connection by default")
+    {
+        const auto plan = make_stream_plan(0, {});
+
+        CHECK_FALSE(plan.parallel);
+        CHECK(plan.connections == 1);
+    }
+
+    SECTION("streams without a size hint use the connections asked for")
+    {
+        transfer_tuning tuning;
+        tuning.connections = 4;
+
+        const auto plan = make_stream_plan(0, tuning);
+
+        CHECK(plan.parallel);
+        CHECK(plan.connections == 4);
+        CHECK(plan.chunk_size > 0);
+    }
+
+    SECTION("a size hint plans the stream like a file")
+    {
+        const auto stream = make_stream_plan(10 * gibibyte, {});
+        const auto file = make_transfer_plan(10 * gibibyte, {});
+
+        CHECK(stream.parallel == file.parallel);
+        CHECK(stream.connections == file.connections);
+        CHECK(stream.chunk_size == file.chunk_size);
+    }
+}
@@ -0,0 +1,113 @@
+#include <catch2/catch.hpp>
+
+#include "sha256_digest.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace irods::cli;
+
+namespace
+{
+    auto digest_of(const std::string& _data) -> std::string
+    {
+        sha256_digest digest;
+        digest.update(_data.data(), _data.size());
+        return digest.finish();
+    }
+
+    auto make_data(std::size_t _size) -> std::string
+    {
+        std::string data(_size, '\0');
+        std::mt19937 gen{42};
+
+        for (auto& c : data) {
+            c = static_cast<char>(gen());
+        }
+
+        return data;
+    }
+} // anonymous namespace
+
+TEST_CASE("sha256_digest produces the iRODS checksum form")
+{
+    // echo -n abc | sha256sum | xxd -r -p | base64
+    CHECK(sha256_digest::to_irods_checksum(digest_of("abc")) == "sha2:ungWv48Bz+pBQUDeXa4iI7ADYaOWF3qctBD/YfIAFa0=");
+}
+
+TEST_CASE("digest_sequencer hashes pieces in stream order")
+{
+    const auto data = make_data(10000);
+    const auto expected = digest_of(data);
+
+    digest_sequencer sequencer{1 << 20};
+
+    SECTION("pieces fed in reverse")
+    {
+        for (std::size_t offset = 9000;; offset -= 1000) {
+            sequencer.feed(offset, data.data() + offset, 1000);
+
+            if (offset == 0) {
+                break;
+            }
+        }
+
+        CHECK(sequencer.finish(data.size()) == expected);
+    }
+
+    SECTION("pieces fed twice, cut differently")
+    {
+        sequencer.feed(5000, data.data() + 5000, 5000);
+        sequencer.feed(2000, data.data() + 2000, 4000);
+        sequencer.feed(0, data.data(), 3000);
+        sequencer.feed(2500, data.data() + 2500, 1000);
+
+        CHECK(sequencer.finish(data.size()) == expected);
+    }
+
+    SECTION("a missing piece yields no digest")
+    {
+        sequencer.feed(0, data.data(), 4000);
+        sequencer.feed(5000, data.data() + 5000, 5000);
+
+        CHECK_FALSE(sequencer.finish(data.size()));
+    }
+
+    SECTION("an abandoned sequencer yields no digest")
+    {
+        sequencer.feed(0, data.data(), data.size());
+        sequencer.abandon();
+
+        CHECK_FALSE(sequencer.finish(data.size()));
+    }
+}
+
+TEST_CASE("digest_sequencer keeps parallel streams within its cap")
+{
+    constexpr std::size_t piece = 4096;
+    constexpr int streams = 4;
+
+    const auto data = make_data(piece * 256);
+    digest_sequencer sequencer{2 * piece};
+    std::vector<std::thread> threads;
+
+    // Stream i feeds pieces i, i + streams, ...; the stream holding the
+    // next piece is never made to wait, so this cannot deadlock.
+    for (int i = 0; i < streams; ++i) {
+        threads.emplace_back([&, i] {
+            for (auto offset = i * piece; offset < data.size(); offset += streams * piece) {
+                sequencer.feed(offset, data.data() + offset, piece);
+            }
+        });
+    }
+
+    for (auto&& t : threads) {
+        t.join();
+    }
+
+    CHECK(sequencer.finish(data.size()) == digest_of(data));
+}
@@ -0,0 +1,156 @@
+#include <catch2/catch.hpp>
+
+#include "listing_format.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace irods::cli;
+
+namespace
+{
+    auto json_string(std::string_view _text) -> std::string
+    {
+        listing_writer out{-1};
+        detail::write_json_string(out, _text);
+        return std::string{out.text()};
+    }
+
+    auto tsv_field(std::string_view _text) -> std::string
+    {
+        listing_writer out{-1};
+        detail::write_tsv_field(out, _text);
+        return std::string{out.text()};
+    }
+} // anonymous namespace
+
+TEST_CASE("parse_listing_format")
+{
+    CHECK(parse_listing_format("text") == listing_format::text);
+    CHECK(parse_listing_format("jsonl") == listing_format::jsonl);
+    CHECK(parse_listing_format("nul") == listing_format::nul);
+    CHECK(parse_listing_format("tsv") == listing_format::tsv);
+    CHECK_FALSE(parse_listing_format("json"));
+    CHECK_FALSE(parse_listing_format(""));
+}
+
+TEST_CASE("jsonl strings are escaped")
+{
+    CHECK(json_string("plain") == R"("plain")");
+    CHECK(json_string("") == R"("")");
+    CHECK(json_string("a\"b\\c") == R"("a\"b\\c")");
+    CHECK(json_string("\n\r\t\b\f") == R"("\n\r\t\b\f")");
+    CHECK(json_string(std::string_view{"\x01\x1f\0", 3}) == R"("\u0001\u001f\u0000")");
+    CHECK(json_string("/") == R"("/")");
+    CHECK(json_string("\x7f") == "\"\x7f\"");
+}
+
+TEST_CASE("jsonl strings keep well-formed UTF-8")
+{
+    CHECK(json_string("caf\xc3\xa9") == "\"caf\xc3\xa9\"");
+    CHECK(json_string("\xe2\x82\xac") == "\"\xe2\x82\xac\"");
+    CHECK(json_string("\xef\xbf\xbf") == "\"\xef\xbf\xbf\"");
+    CHECK(json_string("\xf0\x9f\x98\x80") == "\"\xf0\x9f\x98\x80\"");
+    CHECK(json_string("\xf4\x8f\xbf\xbf") == "\"\xf4\x8f\xbf\xbf\"");
+}
+
+TEST_CASE("jsonl strings replace ill-formed UTF-8")
+{
+    // U+FFFD, written as UTF-8.
+    const std::string replacement = "\xef\xbf\xbd";
+
+    CHECK(json_string("a\xff" "b") == "\"a" + replacement + "b\"");
+    CHECK(json_string("\x80") == '"' + replacement + '"');
+
+    // Well-formed sequences around the damage are kept.
+    CHECK(json_string("\xc3\xa9\xff\xc3\xa9") == "\"\xc3\xa9" + replacement + "\xc3\xa9\"");
+
+    // Truncated sequences, overlong forms, surrogates and code points past
+    // U+10FFFF all leave valid JSON behind.
+    for (const std::string_view text : {"\xf5\x80\x80\x80",
+                                        "\xc3",
+                                        "\xe2\x82x",
+                                        "\xf0\x9f\x98",
+                                        "\xc0\xaf",
+                                        "\xe0\x80\xaf",
+                                        "\xf0\x80\x80\xaf",
+                                        "\xed\xa0\x80",
+                                        "\xf4\x90\x80\x80"})
+    {
+        CAPTURE(text);
+        const auto json = json_string(text);
+        CHECK(json.find(replacement) != std::string::npos);
+        CHECK_NOTHROW(nlohmann::json::parse(json));
+    }
+}
+
+TEST_CASE("tsv fields are escaped")
+{
+    CHECK(tsv_field("plain") == "plain");
+    CHECK(tsv_field("a\tb\nc\rd\\e") == R"(a\tb\nc\rd\\e)");
+    CHECK(tsv_field("\"quoted\"") == "\"quoted\"");
+}
+
+TEST_CASE("write_row")
+{
+    const std::vector<std::string> acls{"rods#own", "alice#read"};
+
+    listing_row row;
+    row.type = "data_object";
+    row.path = "/tempZone/home/rods/a\tb";
+    row.owner = "rods";
+    row.replica = 0;
+    row.resource = "demoResc";
+    row.size = 1024;
+    row.modify_time = 1700000000;
+    row.good = true;
+    row.acls = &acls;
+
+    listing_writer out{-1};
+
+    SECTION("jsonl carries only the fields that are set")
+    {
+        listing_columns columns;
+        columns.replicas = true;
+        columns.acls = true;
+
+        write_row(out, listing_format::jsonl, columns, row);
+
+        CHECK(out.text() == R"({"type":"data_object","path":"/tempZone/home/rods/a\tb","owner":"rods","replica":0,)"
+                            R"("resource":"demoResc","size":1024,"modify_time":1700000000,"good":true,)"
+                            R"("acl":["rods#own","alice#read"]})"
+                            "\n");
+    }
+
+    SECTION("tsv has a column per field of the enabled groups")
+    {
+        listing_columns columns;
+        columns.replicas = true;
+        columns.details = true;
+
+        write_row(out, listing_format::tsv, columns, row);
+
+        CHECK(out.text() == "data_object\t/tempZone/home/rods/a\\tb\trods\t0\tdemoResc\t1024\t1700000000\t1\t\t\n");
+    }
+
+    SECTION("nul ends each path with a NUL byte")
+    {
+        write_row(out, listing_format::nul, {}, row);
+
+        CHECK(out.text() == std::string_view{"/tempZone/home/rods/a\tb\0", 24});
+    }
+}
+
+TEST_CASE("join_logical_path")
+{
+    std::string path = "previous contents";
+
+    join_logical_path(path, "/tempZone/home", "file");
+    CHECK(path == "/tempZone/home/file");
+
+    join_logical_path(path, "/", "tempZone");
+    CHECK(path == "/tempZone");
+}
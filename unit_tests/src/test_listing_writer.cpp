@@ -0,0 +1,104 @@
+#include <catch2/catch.hpp>
+
+#include "listing_writer.hpp"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using irods::cli::listing_writer;
+
+TEST_CASE("listing_writer without a file descriptor collects text")
+{
+    listing_writer out{-1, 16};
+
+    out.write("name");
+    out.print(" {} {}", 42, "bytes");
+    out.fill(' ', 3);
+    out.write("|");
+
+    // Nothing is written out, whatever the block size.
+    CHECK(out.text() == "name 42 bytes   |");
+
+    out.clear();
+    CHECK(out.text().empty());
+}
+
+TEST_CASE("listing_writer writes blocks to its file descriptor")
+{
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+
+    std::string expected;
+
+    {
+        listing_writer out{fds[1], 64};
+
+        for (int i = 0; i < 100; ++i) {
+            out.print("row {}\n", i);
+            expected += "row " + std::to_string(i) + '\n';
+
+            // Never more than a block and a row are buffered.
+            CHECK(out.text().size() < 64);
+        }
+    }
+
+    ::close(fds[1]);
+
+    std::string received;
+    char buffer[4096];
+
+    for (ssize_t n; (n = ::read(fds[0], buffer, sizeof(buffer))) > 0;) {
+        received.append(buffer, static_cast<std::size_t>(n));
+    }
+
+    ::close(fds[0]);
+
+    CHECK(received == expected);
+}
+
+TEST_CASE("listing_writer hands full blocks to its sink")
+{
+    std::vector<std::string> blocks;
+
+    listing_writer out{[&blocks](std::string_view _text) { blocks.emplace_back(_text); }, 8};
+
+    out.write("12345");
+    CHECK(blocks.empty());
+
+    out.write("6789");
+    REQUIRE(blocks.size() == 1);
+    CHECK(blocks[0] == "123456789");
+
+    out.write("ab");
+    out.flush();
+    REQUIRE(blocks.size() == 2);
+    CHECK(blocks[1] == "ab");
+
+    // Flushing nothing hands on nothing.
+    out.flush();
+    CHECK(blocks.size() == 2);
+}
+
+TEST_CASE("listing_writer formats timestamps")
+{
+    ::setenv("TZ", "UTC", 1);
+    ::tzset();
+
+    listing_writer out{-1};
+
+    CHECK(out.timestamp(0) == "1970-01-01 00:00:00");
+    CHECK(out.timestamp(59) == "1970-01-01 00:00:59");
+
+    // Across the cached minute, in both directions.
+    CHECK(out.timestamp(60) == "1970-01-01 00:01:00");
+    CHECK(out.timestamp(1700000000) == "2023-11-14 22:13:20");
+    CHECK(out.timestamp(1700000039) == "2023-11-14 22:13:59");
+    CHECK(out.timestamp(1699999999) == "2023-11-14 22:13:19");
+    CHECK(out.timestamp(1700000040) == "2023-11-14 22:14:00");
+}
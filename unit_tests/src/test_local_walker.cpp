@@ -0,0 +1,161 @@
+#include <catch2/catch.hpp>
+
+#include "local_walker.hpp"
+
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using irods::cli::local_walker;
+
+namespace
+{
+    // A scratch directory tree, removed afterwards.
+    class scratch_dir
+    {
+    public:
+        scratch_dir()
+        {
+            char name[] = "/tmp/irods_cli_walker_XXXXXX";
+            REQUIRE(::mkdtemp(name));
+            path_ = name;
+        }
+
+        ~scratch_dir()
+        {
+            std::system(("rm -rf '" + path_ + "'").c_str());
+        }
+
+        auto path() const -> const std::string&
+        {
+            return path_;
+        }
+
+        auto add_directory(const std::string& _rel) const -> void
+        {
+            REQUIRE(::mkdir((path_ + '/' + _rel).c_str(), 0700) == 0);
+        }
+
+        auto add_file(const std::string& _rel) const -> void
+        {
+            std::ofstream{path_ + '/' + _rel} << _rel;
+        }
+
+    private:
+        std::string path_;
+    };
+
+    // What the callbacks of a walk saw, in order.
+    struct record
+    {
+        std::mutex mtx;
+        std::vector<std::string> directories;
+        std::vector<std::string> files;
+        std::vector<std::string> done;
+        std::vector<std::string> errors;
+
+        auto callbacks() -> local_walker::callbacks
+        {
+            local_walker::callbacks c;
+
+            c.on_directory = [this](const std::string& _rel) {
+                std::lock_guard lk{mtx};
+                directories.push_back(_rel);
+            };
+
+            c.on_file = [this](const std::string& _rel) {
+                std::lock_guard lk{mtx};
+                files.push_back(_rel);
+            };
+
+            c.on_error = [this](const std::string& _path, int) {
+                std::lock_guard lk{mtx};
+                errors.push_back(_path);
+            };
+
+            c.on_directory_done = [this](const std::string& _rel) {
+                std::lock_guard lk{mtx};
+                done.push_back(_rel);
+            };
+
+            return c;
+        }
+    };
+
+    auto sorted(std::vector<std::string> _values) -> std::vector<std::string>
+    {
+        std::sort(std::begin(_values), std::end(_values));
+        return _values;
+    }
+
+    auto position(const std::vector<std::string>& _values, const std::string& _value) -> std::ptrdiff_t
+    {
+        return std::find(std::begin(_values), std::end(_values), _value) - std::begin(_values);
+    }
+} // anonymous namespace
+
+TEST_CASE("local_walker reports every entry once")
+{
+    scratch_dir dir;
+    dir.add_directory("a");
+    dir.add_directory("a/b");
+    dir.add_directory("c");
+    dir.add_file("x");
+    dir.add_file("a/y");
+    dir.add_file("a/b/z");
+    REQUIRE(::symlink("x", (dir.path() + "/link").c_str()) == 0);
+    REQUIRE(::mkfifo((dir.path() + "/fifo").c_str(), 0600) == 0);
+
+    record r;
+    local_walker walker{dir.path(), 4};
+    walker.walk(r.callbacks());
+
+    CHECK(r.errors.empty());
+    CHECK(sorted(r.directories) == std::vector<std::string>{"", "a", "a/b", "c"});
+    CHECK(sorted(r.done) == std::vector<std::string>{"", "a", "a/b", "c"});
+
+    // Symbolic links are followed.
+    CHECK(sorted(r.files) == std::vector<std::string>{"a/b/z", "a/y", "link", "x"});
+
+    // A directory comes before the directories in it.
+    CHECK(position(r.directories, "a") < position(r.directories, "a/b"));
+
+    const auto stats = walker.current_stats();
+    CHECK(stats.directories == 4);
+    CHECK(stats.files == 4);
+    CHECK(stats.others == 1);
+    CHECK(stats.stat_calls >= 1); // The link, at least.
+}
+
+TEST_CASE("local_walker reports progress while a large directory is read")
+{
+    // Far more entries than one getdents64 batch holds.
+    constexpr int count = 20000;
+
+    scratch_dir dir;
+
+    for (int i = 0; i < count; ++i) {
+        dir.add_file("file_with_a_fairly_long_name_" + std::to_string(i));
+    }
+
+    record r;
+    auto callbacks = r.callbacks();
+
+    std::vector<std::uint64_t> progress;
+    callbacks.on_progress = [&progress](const local_walker::stats& _stats) { progress.push_back(_stats.files); };
+
+    // Without an interval, progress is due after every batch.
+    local_walker walker{dir.path(), 1, std::chrono::steady_clock::duration::zero()};
+    walker.walk(callbacks);
+
+    CHECK(r.files.size() == count);
+    REQUIRE(progress.size() > 1);
+    CHECK(progress.front() < count);
+    CHECK(progress.back() == count);
+}
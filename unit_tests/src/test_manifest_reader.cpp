@@ -0,0 +1,81 @@
+#include <catch2/catch.hpp>
+
+#include "manifest_reader.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+using irods::cli::manifest_reader;
+
+namespace
+{
+    struct file_closer
+    {
+        auto operator()(std::FILE* _f) const noexcept -> void
+        {
+            std::fclose(_f);
+        }
+    };
+
+    auto open_memory(std::string& _text) -> std::unique_ptr<std::FILE, file_closer>
+    {
+        return std::unique_ptr<std::FILE, file_closer>{::fmemopen(_text.data(), _text.size(), "r")};
+    }
+} // anonymous namespace
+
+TEST_CASE("manifest_reader reads newline-delimited records")
+{
+    std::string text = "a.txt\n\nb.txt\t/tempZone/home/rods/b.txt\r\nc d.txt";
+    auto in = open_memory(text);
+    REQUIRE(in);
+
+    manifest_reader reader{in.get(), '\n'};
+
+    auto e = reader.next();
+    REQUIRE(e);
+    CHECK(e->source == "a.txt");
+    CHECK(e->destination.empty());
+    CHECK(e->record == 1);
+
+    // The empty record still counts.
+    e = reader.next();
+    REQUIRE(e);
+    CHECK(e->source == "b.txt");
+    CHECK(e->destination == "/tempZone/home/rods/b.txt");
+    CHECK(e->record == 3);
+
+    // The last record may lack its delimiter.
+    e = reader.next();
+    REQUIRE(e);
+    CHECK(e->source == "c d.txt");
+    CHECK(e->record == 4);
+
+    CHECK_FALSE(reader.next());
+}
+
+TEST_CASE("manifest_reader reads NUL-delimited records")
+{
+    const char raw[] = "line\none\0\0two\r\0src\tdst\0";
+    std::string text(raw, sizeof(raw) - 1);
+    auto in = open_memory(text);
+    REQUIRE(in);
+
+    manifest_reader reader{in.get(), '\0'};
+
+    auto e = reader.next();
+    REQUIRE(e);
+    CHECK(e->source == "line\none");
+
+    // A carriage return is part of the name here.
+    e = reader.next();
+    REQUIRE(e);
+    CHECK(e->source == "two\r");
+
+    e = reader.next();
+    REQUIRE(e);
+    CHECK(e->source == "src");
+    CHECK(e->destination == "dst");
+
+    CHECK_FALSE(reader.next());
+}
@@ -0,0 +1,76 @@
+#include <catch2/catch.hpp>
+
+#include "rate_limiter.hpp"
+
+#include <chrono>
+#include <thread>
+
+using irods::cli::rate_limiter;
+
+namespace
+{
+    template <typename Fn>
+    auto elapsed(Fn _fn) -> std::chrono::steady_clock::duration
+    {
+        const auto start = std::chrono::steady_clock::now();
+        _fn();
+        return std::chrono::steady_clock::now() - start;
+    }
+} // anonymous namespace
+
+TEST_CASE("an unlimited rate_limiter never waits")
+{
+    rate_limiter limiter;
+
+    const auto t = elapsed([&] {
+        for (int i = 0; i < 100000; ++i) {
+            limiter.acquire(1'000'000'000);
+        }
+    });
+
+    CHECK(t < std::chrono::seconds{1});
+}
+
+TEST_CASE("rate_limiter spreads units at the configured rate")
+{
+    // 1000 units per second with no burst allowance: 300 units cost at least 0.3 s.
+    rate_limiter limiter{1000, std::chrono::nanoseconds{0}};
+
+    const auto t = elapsed([&] {
+        for (int i = 0; i < 3; ++i) {
+            limiter.acquire(100);
+        }
+    });
+
+    CHECK(t >= std::chrono::milliseconds{250});
+}
+
+TEST_CASE("rate_limiter shares its rate between threads")
+{
+    rate_limiter limiter{1000, std::chrono::nanoseconds{0}};
+
+    const auto t = elapsed([&] {
+        std::thread a{[&] { limiter.acquire(150); }};
+        std::thread b{[&] { limiter.acquire(150); }};
+        a.join();
+        b.join();
+    });
+
+    CHECK(t >= std::chrono::milliseconds{250});
+}
+
+TEST_CASE("lifting the rate wakes sleeping callers")
+{
+    rate_limiter limiter{1, std::chrono::nanoseconds{0}};
+
+    const auto t = elapsed([&] {
+        // Would otherwise sleep for an hour.
+        std::thread sleeper{[&] { limiter.acquire(3600); }};
+        std::this_thread::sleep_for(std::chrono::milliseconds{100});
+        limiter.set_rate(0);
+        sleeper.join();
+    });
+
+    CHECK(limiter.rate() == 0);
+    CHECK(t < std::chrono::seconds{5});
+}
@@ -0,0 +1,34 @@
+#include <catch2/catch.hpp>
+
+#include "retry_policy.hpp"
+
+#include <chrono>
+
+using irods::cli::retry_policy;
+
+TEST_CASE("retry_policy doubles its delay up to the cap")
+{
+    using std::chrono::milliseconds;
+
+    retry_policy policy;
+    policy.initial_delay = milliseconds{100};
+    policy.max_delay = milliseconds{1000};
+
+    // Jitter keeps each delay between half and all of its nominal value.
+    const auto nominal = [](int _attempt) {
+        constexpr long long values[] = {100, 200, 400, 800, 1000, 1000};
+        return values[_attempt];
+    };
+
+    for (int attempt = 0; attempt < 6; ++attempt) {
+        for (int i = 0; i < 100; ++i) {
+            const auto d = policy.delay(attempt).count();
+
+            REQUIRE(d >= nominal(attempt) / 2);
+            REQUIRE(d <= nominal(attempt));
+        }
+    }
+
+    // Large attempt numbers must not overflow.
+    CHECK(policy.delay(1000) <= policy.max_delay);
+}
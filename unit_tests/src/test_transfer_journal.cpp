@@ -0,0 +1,160 @@
+#include <catch2/catch.hpp>
+
+#include "transfer_journal.hpp"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using irods::cli::transfer_journal;
+
+namespace
+{
+    // A scratch directory holding a 10-byte source file, removed afterwards.
+    class scratch_dir
+    {
+    public:
+        scratch_dir()
+        {
+            char name[] = "/tmp/irods_cli_journal_XXXXXX";
+            REQUIRE(::mkdtemp(name));
+            path_ = name;
+
+            std::ofstream{source()} << "0123456789";
+        }
+
+        ~scratch_dir()
+        {
+            std::system(("rm -rf '" + path_ + "'").c_str());
+        }
+
+        auto source() const -> std::string
+        {
+            return path_ + "/source";
+        }
+
+        auto journal() const -> std::string
+        {
+            return path_ + "/journal";
+        }
+
+    private:
+        std::string path_;
+    };
+
+    const std::string target = "/tempZone/home/rods/source";
+} // anonymous namespace
+
+TEST_CASE("transfer_journal round trip")
+{
+    scratch_dir dir;
+
+    {
+        transfer_journal journal{dir.journal(), dir.source(), target, 4};
+
+        CHECK_FALSE(journal.resumed());
+        CHECK(journal.chunk_count() == 3);
+        CHECK(journal.completed() == std::vector<bool>{false, false, false});
+
+        journal.mark_done(2);
+        journal.mark_done(0);
+        CHECK_FALSE(journal.finished());
+    }
+
+    SECTION("a matching journal is resumed")
+    {
+        transfer_journal journal{dir.journal(), dir.source(), target, 4};
+
+        CHECK(journal.resumed());
+        CHECK(journal.completed() == std::vector<bool>{true, false, true});
+        CHECK(journal.completed_count() == 2);
+
+        journal.mark_done(1);
+        CHECK(journal.finished());
+
+        journal.remove();
+        CHECK(::access(dir.journal().c_str(), F_OK) != 0);
+    }
+
+    SECTION("the recorded chunk size wins")
+    {
+        transfer_journal journal{dir.journal(), dir.source(), target, 8};
+
+        CHECK(journal.resumed());
+        CHECK(journal.chunk_size() == 4);
+        CHECK(journal.chunk_count() == 3);
+    }
+
+    SECTION("a journal for another target is discarded")
+    {
+        transfer_journal journal{dir.journal(), dir.source(), target + ".other", 4};
+
+        CHECK_FALSE(journal.resumed());
+    }
+
+    SECTION("a journal for a changed source is discarded")
+    {
+        std::ofstream{dir.source(), std::ios::app} << "more";
+
+        transfer_journal journal{dir.journal(), dir.source(), target, 4};
+
+        CHECK_FALSE(journal.resumed());
+        CHECK(journal.chunk_count() == 4);
+    }
+
+    SECTION("a torn last line is ignored and cut off")
+    {
+        std::ofstream{dir.journal(), std::ios::app} << "done 1";
+
+        {
+            transfer_journal journal{dir.journal(), dir.source(), target, 4};
+
+            CHECK(journal.completed() == std::vector<bool>{true, false, true});
+            journal.mark_done(1);
+        }
+
+        transfer_journal journal{dir.journal(), dir.source(), target, 4};
+
+        CHECK(journal.completed() == std::vector<bool>{true, true, true});
+        CHECK(journal.finished());
+    }
+
+    SECTION("restart forgets completed chunks")
+    {
+        {
+            transfer_journal journal{dir.journal(), dir.source(), target, 4};
+            journal.restart();
+
+            CHECK_FALSE(journal.resumed());
+        }
+
+        transfer_journal journal{dir.journal(), dir.source(), target, 4};
+
+        CHECK_FALSE(journal.resumed());
+    }
+}
+
+TEST_CASE("transfer_journal::path_for")
+{
+    SECTION("without a state directory the journal sits next to the source")
+    {
+        CHECK(transfer_journal::path_for("/data/file.bin", target, "") == "/data/.file.bin.irods-put-journal");
+        CHECK(transfer_journal::path_for("file.bin", target, "") == ".file.bin.irods-put-journal");
+    }
+
+    SECTION("within a state directory the name depends on source and target")
+    {
+        const auto a = transfer_journal::path_for("/data/a", target, "/state");
+        const auto b = transfer_journal::path_for("/data/b", target, "/state");
+
+        CHECK(a.rfind("/state/", 0) == 0);
+        CHECK(a.size() == std::string{"/state/"}.size() + 16 + std::string{".journal"}.size());
+        CHECK(a == transfer_journal::path_for("/data/a", target, "/state"));
+        CHECK(a != b);
+        CHECK(a != transfer_journal::path_for("/data/a", target + ".other", "/state"));
+    }
+}
@@ -0,0 +1,283 @@
+#include <catch2/catch.hpp>
+
+#include "transfer_scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace irods::cli;
+
+namespace
+{
+    struct context
+    {
+    };
+
+    using scheduler_type = transfer_scheduler<int, context>;
+
+    // What the workers of a test did.
+    struct record
+    {
+        std::mutex mtx;
+        std::vector<int> small;
+        std::vector<int> led;
+        std::vector<std::uint64_t> chunks;
+        std::atomic<int> joins{0};
+
+        auto take_chunks(chunk_scheduler& _chunks) -> void
+        {
+            while (const auto c = _chunks.next()) {
+                _chunks.mark_done(*c);
+
+                std::lock_guard lk{mtx};
+                chunks.push_back(c->index);
+            }
+        }
+    };
+
+    // Does what the transfer workers of put and get do, without moving any data.
+    auto run_worker(scheduler_type& _scheduler, record& _record) -> void
+    {
+        while (auto work = _scheduler.next()) {
+            switch (work->kind) {
+                case scheduler_type::work_kind::small: {
+                    {
+                        std::lock_guard lk{_record.mtx};
+                        _record.small.push_back(work->task);
+                    }
+
+                    _scheduler.complete_small();
+                    break;
+                }
+
+                case scheduler_type::work_kind::lead: {
+                    {
+                        std::lock_guard lk{_record.mtx};
+                        _record.led.push_back(work->large->task);
+                    }
+
+                    _scheduler.publish(work->large);
+                    _record.take_chunks(work->large->chunks);
+                    _scheduler.wait_for_helpers(work->large);
+                    _scheduler.finish(work->large);
+                    break;
+                }
+
+                case scheduler_type::work_kind::join:
+                    ++_record.joins;
+                    _record.take_chunks(work->large->chunks);
+                    _scheduler.leave(work->large);
+                    break;
+            }
+        }
+    }
+
+    auto sorted(std::vector<int> _values) -> std::vector<int>
+    {
+        std::sort(std::begin(_values), std::end(_values));
+        return _values;
+    }
+} // anonymous namespace
+
+TEST_CASE("transfer_scheduler hands out every small task once")
+{
+    constexpr int count = 10000;
+
+    scheduler_type scheduler{4, 64};
+    record r;
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < 4; ++i) {
+        workers.emplace_back([&] { run_worker(scheduler, r); });
+    }
+
+    for (int i = 0; i < count; ++i) {
+        scheduler.add_small(int{i});
+    }
+
+    scheduler.close();
+
+    for (auto&& t : workers) {
+        t.join();
+    }
+
+    std::vector<int> expected(count);
+
+    for (int i = 0; i < count; ++i) {
+        expected[i] = i;
+    }
+
+    CHECK(sorted(r.small) == expected);
+    CHECK(r.led.empty());
+}
+
+TEST_CASE("transfer_scheduler lets idle workers join large transfers")
+{
+    constexpr std::uint64_t chunk_count = 2000;
+
+    scheduler_type scheduler{4};
+    record r;
+
+    scheduler.add_large(1, chunk_count, 1, 4);
+    scheduler.add_large(2, chunk_count / 2, 1, 4);
+    scheduler.close();
+
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < 4; ++i) {
+        workers.emplace_back([&] { run_worker(scheduler, r); });
+    }
+
+    for (auto&& t : workers) {
+        t.join();
+    }
+
+    CHECK(sorted(r.led) == std::vector<int>{1, 2});
+    CHECK(r.chunks.size() == chunk_count + chunk_count / 2);
+}
+
+TEST_CASE("transfer_scheduler starts the biggest pending file first")
+{
+    scheduler_type scheduler{1};
+
+    scheduler.add_large(1, 10, 1, 1);
+    scheduler.add_large(2, 30, 1, 1);
+    scheduler.add_large(3, 20, 1, 1);
+    scheduler.close();
+
+    for (const auto expected : {2, 3, 1}) {
+        auto work = scheduler.next();
+        REQUIRE(work);
+        REQUIRE(work->kind == scheduler_type::work_kind::lead);
+        CHECK(work->large->task == expected);
+
+        scheduler.publish(work->large);
+        record{}.take_chunks(work->large->chunks);
+        scheduler.wait_for_helpers(work->large);
+        scheduler.finish(work->large);
+    }
+
+    CHECK_FALSE(scheduler.next());
+}
+
+TEST_CASE("transfer_scheduler mixes small and promoted tasks")
+{
+    scheduler_type scheduler{2, 16};
+    record r;
+
+    // A task taken as small that turns out to be large is promoted by the
+    // worker that found out.
+    scheduler.add_small(7);
+
+    auto work = scheduler.next();
+    REQUIRE(work);
+    REQUIRE(work->kind == scheduler_type::work_kind::small);
+
+    CHECK(scheduler.promote(std::move(work->task), 10, 1, 2) == nullptr);
+    scheduler.complete_small();
+
+    std::thread a{[&] { run_worker(scheduler, r); }};
+    std::thread b{[&] { run_worker(scheduler, r); }};
+
+    for (int i = 0; i < 100; ++i) {
+        scheduler.add_small(int{i});
+    }
+
+    scheduler.close();
+
+    a.join();
+    b.join();
+
+    CHECK(r.led == std::vector<int>{7});
+    CHECK(r.chunks.size() == 10);
+    CHECK(r.small.size() == 100);
+}
+
+TEST_CASE("transfer_scheduler caps promoted large files")
+{
+    // One worker and a small queue leave room for a single pending large file.
+    scheduler_type scheduler{1, 16};
+    record r;
+
+    for (int i = 0; i < 5; ++i) {
+        scheduler.add_small(int{i});
+    }
+
+    // The worker takes the whole batch, as put does.
+    auto work = scheduler.next();
+    REQUIRE(work);
+    REQUIRE(work->kind == scheduler_type::work_kind::small);
+
+    std::vector<int> batch{work->task};
+
+    while (const auto task = scheduler.try_next_small()) {
+        batch.push_back(*task);
+    }
+
+    REQUIRE(batch.size() == 5);
+
+    // Every promotion past the cap makes the promoting worker lead the
+    // biggest pending file, whether its own or an earlier one.
+    std::vector<int> led_by_promoter;
+
+    for (const auto task : batch) {
+        const std::uint64_t size = task == 2 ? 100 : 10 + task;
+        auto large = scheduler.promote(task, size, 1, 1);
+        scheduler.complete_small();
+
+        CHECK((task == 0) == (large == nullptr));
+
+        if (large) {
+            led_by_promoter.push_back(large->task);
+            scheduler.publish(large);
+            r.take_chunks(large->chunks);
+            scheduler.wait_for_helpers(large);
+            scheduler.finish(large);
+        }
+    }
+
+    CHECK(led_by_promoter == std::vector<int>{1, 2, 3, 4});
+
+    scheduler.close();
+    run_worker(scheduler, r);
+
+    // The one that was left pending.
+    CHECK(r.led == std::vector<int>{0});
+}
+
+TEST_CASE("transfer_scheduler admits no helper once the leader waits to finalize")
+{
+    scheduler_type scheduler{2};
+
+    scheduler.add_large(1, 4, 1, 2);
+    scheduler.close();
+
+    auto work = scheduler.next();
+    REQUIRE(work);
+    REQUIRE(work->kind == scheduler_type::work_kind::lead);
+
+    auto& large = work->large;
+    scheduler.publish(large);
+
+    std::vector<chunk> taken;
+
+    while (const auto c = large->chunks.next()) {
+        taken.push_back(*c);
+    }
+
+    scheduler.wait_for_helpers(large);
+
+    // A unit handed back late gives the transfer work again, but it is the
+    // leader's to send; another worker must not join.
+    large->chunks.requeue(taken.back());
+    CHECK_FALSE(scheduler.next());
+
+    const auto again = large->chunks.next();
+    REQUIRE(again);
+    CHECK(again->index == taken.back().index);
+
+    scheduler.finish(large);
+}